@@ -0,0 +1,15 @@
+#version 330 core
+
+// The vertex shader of the depth pre-pass for the instanced draws
+// (the same expression as "textured-instanced.vert" & "lighted-instanced.vert", see "depth.vert")
+layout(location = 0) in vec3 position;
+layout(location = 4) in mat4 instance_M;
+
+uniform mat4 VP; // view * projection matrix
+
+invariant gl_Position;
+
+void main(){
+    vec3 world = (instance_M * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+
+// The vertex shader of the depth pre-pass for the objects drawn with "lighted.vert"
+// (the same expression as "lighted.vert", see "depth.vert")
+layout(location = 0) in vec3 position;
+
+uniform mat4 VP; // view * projection matrix
+uniform mat4 M;  // model matrix
+
+invariant gl_Position;
+
+void main(){
+    vec3 world = (M * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+}
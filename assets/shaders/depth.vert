@@ -0,0 +1,14 @@
+#version 330 core
+
+// The vertex shader of the depth pre-pass for the objects drawn with "tinted.vert" or "textured.vert"
+// It computes the position with the same expression & the same "transform" uniform, and "invariant" makes sure
+// that both programs get exactly the same depth (so the main pass can test against it with GL_LEQUAL).
+layout(location = 0) in vec3 position;
+
+uniform mat4 transform;
+
+invariant gl_Position;
+
+void main(){
+    gl_Position = transform * vec4(position, 1.0);
+}
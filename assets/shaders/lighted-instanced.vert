@@ -0,0 +1,35 @@
+#version 330
+
+// The instanced variant of "lighted.vert": the model matrix & its inverse transpose are per-instance attributes
+// (see "Mesh::setInstanceData") instead of uniforms.
+uniform vec3 eye;//eye
+uniform mat4 VP;//view * position matrix
+
+layout(location=0) in vec3 position;
+layout(location=1) in vec4 color;
+layout(location=2) in vec2 tex_coord;
+layout(location=3) in vec3 normal;
+// Each mat4 attribute takes 4 locations (one per column)
+layout(location=4) in mat4 instance_M;    // model matrix (locations 4 to 7)
+layout(location=8) in mat4 instance_M_IT; // model matrix inverse transpose (locations 8 to 11)
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+    vec3 normal;
+    vec3 view;
+    vec3 world;
+} vs_out;
+
+// The depth pre-pass computes the same position in "depth-instanced.vert", so it must not change between programs
+invariant gl_Position;
+
+void main(){
+    vec3 world = (instance_M * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+    vs_out.normal = normalize((instance_M_IT * vec4(normal, 0.0)).xyz);
+    vs_out.view = eye - world;
+    vs_out.world = world;
+}
@@ -1,7 +1,5 @@
 #version 330
 
-#define MAX_LIGHTS 64
-
 // set DIRECTIONAL to 0
 #define DIRECTIONAL 0
 
@@ -11,6 +9,10 @@
 // set SPOT to 2
 #define SPOT 2
 
+// NOTE: The sky & the cluster grid are read from the "Lighting" uniform block below (std140 layout).
+// The renderer fills one buffer per frame that is shared by every program declaring the block,
+// so any change here must be mirrored in "LightingBlock" in "forward-renderer.hpp".
+// The lights are read from texture buffers since there can be hundreds of them (see "LightClusters").
 struct Light {
     //type of light spot , directional ,point
     int type;
@@ -25,14 +27,35 @@ struct Light {
     vec2 coneAngles; // x: inner angle, y: outer angle for spot light
 };
 
-uniform Light lights[MAX_LIGHTS];
-uniform int light_count;
 //struct for sky light
 struct Sky {
     vec3 top, middle, bottom;
 };
-//sky light from forward render
-uniform Sky sky;
+
+layout(std140) uniform Lighting {
+    // the view matrix of the camera (used to find the depth of the fragment)
+    mat4 view_matrix;
+    //sky light from forward render
+    Sky sky;
+    // xyz: the number of clusters on each axis, w: the number of directional lights (the first lights of the buffer)
+    uvec4 cluster_count;
+    // xy: the clusters per pixel, z: the depth where the first slice starts, w: the slices per unit of log(depth)
+    vec4 cluster_scale;
+};
+
+// Each light is 5 texels (see "ClusterLight" in "light-clusters.hpp")
+uniform samplerBuffer light_data;
+// For each cluster, the offset of its list in "light_indices" and the number of lights in it
+uniform usamplerBuffer light_grid;
+// The lists of the light indices of the clusters
+uniform usamplerBuffer light_indices;
+
+// The size of "object_lights" (must match MAX_OBJECT_LIGHTS in "forward-renderer.hpp")
+#define MAX_OBJECT_LIGHTS 16
+// The indices of the point & spot lights chosen for this object by the renderer (when the renderer uses per-object lists)
+// If the count is negative, the lights are read from the list of the fragment's cluster instead.
+uniform int object_lights[MAX_OBJECT_LIGHTS];
+uniform int object_light_count;
 
 // struct for material 
 // albedo: which is used to represent the diffuse of the material.
@@ -63,6 +86,53 @@ in Varyings {
 
 out vec4 frag_color;
 
+Light read_light(int index){
+    int base = index * 5;
+    vec4 texels[5];
+    for(int i = 0; i < 5; i++) texels[i] = texelFetch(light_data, base + i);
+    Light light;
+    light.type = int(texels[0].w);
+    light.position = texels[0].xyz;
+    light.direction = texels[1].xyz;
+    light.diffuse = texels[2].xyz;
+    light.specular = texels[3].xyz;
+    light.attenuation = texels[4].xyz;
+    light.coneAngles = vec2(texels[2].w, texels[3].w);
+    return light;
+}
+
+// Returns the light reflected by the surface toward the eye
+vec3 shade(Light light, vec3 normal, vec3 view, vec3 material_diffuse, vec3 material_specular, float material_shininess){
+       // Then we get the light direction 
+    vec3 direction_to_light = normalize(-light.direction);
+    if(light.type != DIRECTIONAL){
+        direction_to_light = normalize(light.position - fs_in.world);
+    }
+
+      // Now we compute the  components of the light separately.
+    
+    vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
+    
+    vec3 reflected = reflect(-direction_to_light, normal); // this is used for specular
+    
+    vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
+
+    float attenuation = 1;
+    if(light.type != DIRECTIONAL){
+        //distance relative to the pixel location in the world space.
+        float d = distance(light.position, fs_in.world);
+        attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
+        if(light.type == SPOT){
+            // Then we calculate the angle between the pixel and the cone axis.
+            float angle = acos(dot(-direction_to_light, light.direction));
+             // And we calculate the attenuation based on the angle.
+            attenuation *= smoothstep(light.coneAngles.y, light.coneAngles.x, angle);
+        }
+    }
+     // Then we combine the light component .
+    return (diffuse + specular) * attenuation;
+}
+
 void main(){
     // First we normalize the normal and the view.
     vec3 view = normalize(fs_in.view);
@@ -82,37 +152,27 @@ void main(){
         mix(sky.middle, sky.bottom, normal.y * normal.y);
 
     frag_color = vec4(material_emissive + material_ambient * sky_light , 1.0);
-     //get light counts
-    int clamped_light_count = min(MAX_LIGHTS, light_count);
-    for(int i = 0; i < clamped_light_count; i++){
-        Light light = lights[i];
-           // Then we get the light direction 
-        vec3 direction_to_light = normalize(-light.direction);
-        if(light.type != DIRECTIONAL){
-            direction_to_light = normalize(light.position - fs_in.world);
-        }
-
-          // Now we compute the  components of the light separately.
-        
-        vec3 diffuse = light.diffuse * material_diffuse * max(0, dot(normal, direction_to_light));
-        
-        vec3 reflected = reflect(-direction_to_light, normal); // this is used for specular
-        
-        vec3 specular = light.specular * material_specular * pow(max(0, dot(view, reflected)), material_shininess);
-
-        float attenuation = 1;
-        if(light.type != DIRECTIONAL){
-            //distance relative to the pixel location in the world space.
-            float d = distance(light.position, fs_in.world);
-            attenuation /= dot(light.attenuation, vec3(d*d, d, 1));
-            if(light.type == SPOT){
-                // Then we calculate the angle between the pixel and the cone axis.
-                float angle = acos(dot(-direction_to_light, light.direction));
-                 // And we calculate the attenuation based on the angle.
-                attenuation *= smoothstep(light.coneAngles.y, light.coneAngles.x, angle);
-            }
+    // the directional lights reach every fragment
+    for(int i = 0; i < int(cluster_count.w); i++){
+        frag_color.rgb += shade(read_light(i), normal, view, material_diffuse, material_specular, material_shininess);
+    }
+    // the renderer may have chosen the lights of this object already
+    if(object_light_count >= 0){
+        for(int i = 0; i < min(object_light_count, MAX_OBJECT_LIGHTS); i++){
+            frag_color.rgb += shade(read_light(object_lights[i]), normal, view, material_diffuse, material_specular, material_shininess);
         }
-         // Then we combine the light component .
-        frag_color.rgb += (diffuse + specular) * attenuation;
+        return;
+    }
+    // find the cluster of the fragment from its pixel & its depth (the same slices as "LightClusters")
+    float depth = -(view_matrix * vec4(fs_in.world, 1.0)).z;
+    uvec3 cluster_max = cluster_count.xyz - uvec3(1);
+    uvec3 cluster = uvec3(max(vec3(gl_FragCoord.xy * cluster_scale.xy, log(depth / cluster_scale.z) * cluster_scale.w), vec3(0)));
+    cluster = min(cluster, cluster_max);
+    int cluster_index = int((cluster.z * cluster_count.y + cluster.y) * cluster_count.x + cluster.x);
+    // then we only evaluate the point & spot lights that can reach the cluster
+    uvec2 list = texelFetch(light_grid, cluster_index).xy;
+    for(uint i = 0u; i < list.y; i++){
+        int index = int(texelFetch(light_indices, int(list.x + i)).x);
+        frag_color.rgb += shade(read_light(index), normal, view, material_diffuse, material_specular, material_shininess);
     }
 }
\ No newline at end of file
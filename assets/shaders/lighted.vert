@@ -19,6 +19,9 @@ out Varyings {
     vec3 world;
 } vs_out;
 
+// The depth pre-pass computes the same position in "depth-lit.vert", so it must not change between programs
+invariant gl_Position;
+
 void main(){
     // First we compute the world position.
     vec3 world = (M * vec4(position, 1.0)).xyz;
@@ -0,0 +1,26 @@
+#version 330 core
+
+// The instanced variant of "textured.vert": each instance reads its model matrix from a per-instance attribute
+// (see "Mesh::setInstanceData") and the view projection matrix is shared by the whole draw.
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+// A mat4 attribute takes 4 locations (one per column), so this reads the locations 4 to 7
+layout(location = 4) in mat4 instance_M;
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+} vs_out;
+
+uniform mat4 VP;
+
+// The depth pre-pass computes the same position in "depth-instanced.vert", so it must not change between programs
+invariant gl_Position;
+
+void main(){
+    vec3 world = (instance_M * vec4(position, 1.0)).xyz;
+    gl_Position = VP * vec4(world, 1.0);
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+}
@@ -9,6 +9,9 @@ out Varyings {
 
 uniform mat4 transform;
 
+// The depth pre-pass computes the same position in "depth.vert", so it must not change between programs
+invariant gl_Position;
+
 void main(){
     //TODO: (Req 7) Change the next line to apply the transformation matrix
     gl_Position = transform * vec4(position, 1.0);
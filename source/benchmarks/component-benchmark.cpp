@@ -0,0 +1,162 @@
+#include <ecs/world.hpp>
+#include <components/component-deserializer.hpp>
+#include <systems/movement.hpp>
+#include <ecs/transform-batch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <list>
+#include <string>
+#include <vector>
+
+// This benchmark compares the component lookup by type ID (the entity's signature) with the lookup that walks
+// a list of components calling dynamic_cast on each one, and the hashed component factory table with the chain of
+// string comparisons that "deserializeComponent" used to do.
+// It also compares the scalar loop of "MovementSystem" with integrating SoA batches of the transforms with the SIMD kernel.
+// Usage: COMPONENT_BENCHMARK [entities] [repetitions]
+
+namespace {
+
+    // The old lookup: the first component in the list that can be cast to T
+    template<typename T>
+    T* findByCast(const std::list<our::Component*>& components) {
+        for(auto component : components)
+            if(T* result = dynamic_cast<T*>(component)) return result;
+        return nullptr;
+    }
+
+    // The old IDs were returned as a new std::string every time "getID()" was called
+    template<typename T>
+    std::string oldID() { return std::string(T::getID()); }
+
+    // The old dispatch: the type is copied out of the json and compared against the ID of every component type in turn
+    int dispatchByComparison(const nlohmann::json& data) {
+        std::string type = data.value("type", "");
+        if(type == oldID<our::CameraComponent>()) return 0;
+        else if(type == oldID<our::FreeCameraControllerComponent>()) return 1;
+        else if(type == oldID<our::MovementComponent>()) return 2;
+        else if(type == oldID<our::LightComponent>()) return 3;
+        else if(type == oldID<our::MeshRendererComponent>()) return 4;
+        else if(type == oldID<our::RunningObject>()) return 5;
+        else if(type == oldID<our::CollisionComponent>()) return 6;
+        return -1;
+    }
+
+    // The new dispatch (the same steps as "deserializeComponent" without creating the component, so that only the lookup is measured)
+    int dispatchByHash(const nlohmann::json& data) {
+        auto typeIt = data.find("type");
+        if(typeIt == data.end() || !typeIt->is_string()) return -1;
+        std::string_view type = typeIt->get_ref<const std::string&>();
+        const auto& factories = our::getComponentFactories();
+        auto it = factories.find(our::hashComponentName(type));
+        if(it == factories.end() || it->second.name != type) return -1;
+        return (int)(it->first & 0xFF);
+    }
+
+    // The movement integrated on SoA batches: the positions & rotations are gathered into a batch, integrated 4 or 8 at a time
+    // by the SIMD kernel, then written back. The storage of the transforms is still one Transform per entity.
+    void integrateBatches(our::World& world, float deltaTime) {
+        world.view<our::MovementComponent>().parallelEachRange([deltaTime](our::Entity* const* entities, size_t count){
+            our::TransformBatch transforms;
+            our::VelocityBatch velocities;
+            for(size_t first = 0; first < count; first += our::TransformBatch::CAPACITY){
+                transforms.count = std::min(count - first, our::TransformBatch::CAPACITY);
+                for(size_t index = 0; index < transforms.count; index++){
+                    our::Entity* entity = entities[first + index];
+                    our::MovementComponent* movement = entity->getComponent<our::MovementComponent>();
+                    transforms.loadPositionRotation(index, entity->getLocalTransform());
+                    velocities.load(index, movement->linearVelocity, movement->angularVelocity);
+                }
+                our::kernels::integrate(transforms, velocities, deltaTime);
+                for(size_t index = 0; index < transforms.count; index++)
+                    entities[first + index]->setPositionRotation(transforms.getPosition(index), transforms.getRotation(index));
+            }
+        });
+    }
+
+    // Runs "function" the given number of times and returns the average time of a run in nanoseconds
+    template<typename F>
+    double measure(int repetitions, F&& function) {
+        auto start = std::chrono::steady_clock::now();
+        for(int repetition = 0; repetition < repetitions; repetition++) function();
+        auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / repetitions;
+    }
+
+    void report(const char* name, double newTime, double oldTime, size_t operations, const char* oldName = "old") {
+        std::cout << name << ": " << newTime / operations << " ns (" << oldName << ": " << oldTime / operations << " ns, "
+                  << oldTime / newTime << "x faster)" << std::endl;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    size_t entityCount = argc > 1 ? (size_t)std::atoi(argv[1]) : 10000;
+    int repetitions = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    // Every entity gets the components of an obstacle in the game. The same components are also kept in a list
+    // in the order they were added, which is what the entities stored before the type IDs.
+    our::World world;
+    std::vector<our::Entity*> entities;
+    std::vector<std::list<our::Component*>> lists(entityCount);
+    for(size_t index = 0; index < entityCount; index++) {
+        our::Entity* entity = world.add();
+        lists[index] = { entity->addComponent<our::MeshRendererComponent>(), entity->addComponent<our::MovementComponent>(),
+                         entity->addComponent<our::CollisionComponent>() };
+        entities.push_back(entity);
+    }
+
+    // The collision component is the last one in the lists, like in the scene files
+    size_t found = 0;
+    double byID = measure(repetitions, [&](){
+        for(auto entity : entities) found += entity->getComponent<our::CollisionComponent>() != nullptr;
+    });
+    double byCast = measure(repetitions, [&](){
+        for(auto& list : lists) found += findByCast<our::CollisionComponent>(list) != nullptr;
+    });
+    // A type that the entities don't have is the worst case of the list walk
+    double missByID = measure(repetitions, [&](){
+        for(auto entity : entities) found += entity->getComponent<our::CameraComponent>() != nullptr;
+    });
+    double missByCast = measure(repetitions, [&](){
+        for(auto& list : lists) found += findByCast<our::CameraComponent>(list) != nullptr;
+    });
+
+    // The component objects of a typical scene (the camera & the lights are rare, the obstacles are many)
+    std::vector<nlohmann::json> objects;
+    for(size_t index = 0; index < entityCount; index++) {
+        objects.push_back({{"type", std::string(our::MeshRendererComponent::getID())}, {"mesh", "cube"}});
+        objects.push_back({{"type", std::string(our::CollisionComponent::getID())}, {"layer", "obstacle"}});
+        if(index % 100 == 0) objects.push_back({{"type", std::string(our::LightComponent::getID())}, {"color", {1, 1, 1}}});
+    }
+    long long dispatched = 0;
+    double byHash = measure(repetitions, [&](){
+        for(auto& object : objects) dispatched += dispatchByHash(object);
+    });
+    double byComparison = measure(repetitions, [&](){
+        for(auto& object : objects) dispatched += dispatchByComparison(object);
+    });
+
+    // Every entity has a movement component. The dirty transforms are resolved after each run like in a simulation step.
+    our::MovementSystem movementSystem;
+    float deltaTime = 1.0f / 60.0f;
+    double scalarMovement = measure(repetitions, [&](){
+        movementSystem.update(&world, deltaTime);
+        world.updateTransforms();
+    });
+    double batchedMovement = measure(repetitions, [&](){
+        integrateBatches(world, deltaTime);
+        world.updateTransforms();
+    });
+
+    std::cout << entityCount << " entities, " << repetitions << " repetitions" << std::endl;
+    report("getComponent (present)", byID, byCast, entities.size());
+    report("getComponent (missing)", missByID, missByCast, entities.size());
+    report("deserializeComponent dispatch", byHash, byComparison, objects.size());
+    report("MovementSystem::update (scalar)", scalarMovement, batchedMovement, entities.size(), "SoA batches");
+    // Printing the sums keeps the compiler from removing the loops
+    std::cout << "(checksums: " << found << ", " << dispatched << ")" << std::endl;
+    return 0;
+}
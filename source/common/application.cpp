@@ -6,6 +6,8 @@
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <cmath>
+#include <algorithm>
 #include <queue>
 #include <tuple>
 #include <filesystem>
@@ -31,6 +33,7 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "gl-state.hpp"
 
 std::string default_screenshot_filepath() {
     std::stringstream stream;
@@ -155,6 +158,19 @@ our::WindowConfiguration our::Application::getWindowConfiguration() {
     return {title, {width, height}, isFullScreen};
 }
 
+// Reads the settings of the fixed timestep loop. Every setting is optional.
+our::SimulationConfiguration our::Application::getSimulationConfiguration() {
+    SimulationConfiguration config;
+    if(!app_config.contains("simulation")) return config;
+    auto& simulation_config = app_config["simulation"];
+    // The rate is given in steps per second since it is easier to read than a timestep
+    double rate = simulation_config.value("rate", 1.0 / config.timestep);
+    if(rate > 0) config.timestep = 1.0 / rate;
+    config.maxStepsPerFrame = std::max(1, simulation_config.value("maxStepsPerFrame", config.maxStepsPerFrame));
+    config.lockstep = simulation_config.value("lockstep", config.lockstep);
+    return config;
+}
+
 // This is the main class function that run the whole application (Initialize, Game loop, House cleaning).
 // run_for_frames decides how many frames should be run before the application automatically closes.
 // if run_for_frames == 0, the application runs indefinitely till manually closed.
@@ -250,6 +266,9 @@ int our::Application::run(int run_for_frames) {
     // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
     if(currentState) currentState->onInitialize();
 
+    simulation = getSimulationConfiguration();
+    accumulator = 0;
+
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
     double last_frame_time = glfwGetTime();
     int current_frame = 0;
@@ -515,10 +534,41 @@ int our::Application::run(int run_for_frames) {
         // Get the current time (the time at which we are starting the current frame).
         double current_frame_time = glfwGetTime();
 
+        double frame_time = current_frame_time - last_frame_time;
+
+        // The input is sampled once per frame, so every step of this frame sees the same input
+        if(currentState) currentState->onBeginFrame(frame_time);
+
+        // The simulation advances in fixed steps so that it doesn't depend on the frame rate.
+        // The frame time is accumulated, then as many whole steps as fit in the accumulator are run.
+        stepsThisFrame = 0;
+        if(simulation.lockstep){
+            if(currentState) currentState->onFixedUpdate(simulation.timestep);
+            stepsThisFrame = 1;
+            accumulator = 0;
+        } else {
+            accumulator += frame_time;
+            while(accumulator >= simulation.timestep && stepsThisFrame < simulation.maxStepsPerFrame){
+                if(currentState) currentState->onFixedUpdate(simulation.timestep);
+                accumulator -= simulation.timestep;
+                ++stepsThisFrame;
+            }
+            // If the steps can't keep up (e.g. after a long stall), we drop the whole steps we couldn't run
+            // instead of trying to catch up in the next frames and falling further behind (the "spiral of death")
+            if(accumulator >= simulation.timestep) accumulator = std::fmod(accumulator, simulation.timestep);
+        }
+        interpolationAlpha = accumulator / simulation.timestep;
+
         // Call onDraw, in which we will draw the current frame, and send to it the time difference between the last and current frame
-        if(currentState) currentState->onDraw(current_frame_time - last_frame_time);
+        if(currentState) currentState->onDraw(frame_time);
         last_frame_time = current_frame_time; // Then update the last frame start time (this frame is now the last frame)
 
+#if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
+        // In debug builds, the shadow copy of the OpenGL state is checked against the real state once per frame
+        our::GLState::get().validate();
+#endif
+        our::GLState::get().endFrame();
+
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Since ImGui causes many messages to be thrown, we are temporarily disabling the debug messages till we render the ImGui
         glDisable(GL_DEBUG_OUTPUT);
@@ -569,6 +619,9 @@ int our::Application::run(int run_for_frames) {
             nextState = nullptr;
             // Initialize the new scene
             currentState->onInitialize();
+            // The time spent initializing the new scene shouldn't be simulated
+            accumulator = 0;
+            last_frame_time = glfwGetTime();
         }
 
         ++current_frame;
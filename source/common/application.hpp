@@ -33,6 +33,8 @@ namespace our {
     public:
         virtual void onInitialize(){}                   // Called once before the game loop.
         virtual void onImmediateGui(){}                 // Called every frame to draw the Immediate GUI (if any).
+        virtual void onBeginFrame(double /*deltaTime*/){} // Called once per frame before the fixed steps (to sample the input used by all the steps of the frame).
+        virtual void onFixedUpdate(double /*fixedDeltaTime*/){} // Called zero or more times per frame (before "onDraw") to advance the simulation by a fixed step.
         virtual void onDraw(double deltaTime){}         // Called every frame in the game loop passing the time taken to draw the frame "Delta time".
         virtual void onDestroy(){}                      // Called once after the game loop ends for house cleaning.
 
@@ -48,6 +50,13 @@ namespace our {
         Application* getApp() { return application; }
     };
 
+    // This struct holds the settings of the fixed timestep simulation loop (read from the "simulation" object in the app config)
+    struct SimulationConfiguration {
+        double timestep = 1.0 / 60.0;   // The simulated time advanced by each call to "State::onFixedUpdate"
+        int maxStepsPerFrame = 5;       // The most steps run in one frame. The time beyond that is dropped so a slow frame can't cause even slower frames.
+        bool lockstep = false;          // If true, exactly one step runs per frame whatever the frame time is (for reproducible benchmarks)
+    };
+
     // This class act as base class for all the Applications covered in the examples.
     // It offers the functionalities needed by all the examples.
     class Application {
@@ -69,6 +78,12 @@ namespace our {
         virtual void configureOpenGL();                             // This function sets OpenGL Window Hints in GLFW.
         virtual WindowConfiguration getWindowConfiguration();       // Returns the WindowConfiguration current struct instance.
         virtual void setupCallbacks();                              // Sets-up the window callback functions from GLFW to our (Mouse/Keyboard) classes.
+        virtual SimulationConfiguration getSimulationConfiguration(); // Returns the settings of the fixed timestep loop.
+
+        SimulationConfiguration simulation;  // The settings of the fixed timestep loop
+        double accumulator = 0;              // The frame time that is not simulated yet
+        double interpolationAlpha = 0;       // The fraction of a step left in the accumulator after the steps of this frame
+        int stepsThisFrame = 0;              // The number of simulation steps run in this frame
 
     public:
         int reward;
@@ -127,6 +142,12 @@ namespace our {
 
         [[nodiscard]] const nlohmann::json& getConfig() const { return app_config; }
 
+        // Returns how far (from 0 to 1) the current frame is between the last simulation step and the next one
+        // States blend the last two simulation states by this factor when rendering (see "World::interpolateTransforms").
+        [[nodiscard]] double getInterpolationAlpha() const { return interpolationAlpha; }
+        [[nodiscard]] int getStepsThisFrame() const { return stepsThisFrame; }
+        [[nodiscard]] const SimulationConfiguration& getSimulation() const { return simulation; }
+
         // Get the size of the frame buffer of the window in pixels.
         glm::ivec2 getFrameBufferSize() {
             glm::ivec2 size;
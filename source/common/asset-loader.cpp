@@ -14,6 +14,9 @@ namespace our {
     // This will load all the shaders defined in "data"
     // data must be in the form:
     //    { shader_name : { "vs" : "path/to/vertex-shader", "fs" : "path/to/fragment-shader" }, ... }
+    // A shader can also have "instancedVs": "path/to/vertex-shader" which creates its instanced variant
+    // (the same fragment shader with a vertex shader reading the model matrices from per-instance attributes).
+    // The variant is stored as an asset named "shader_name-instanced".
     template<>
     void AssetLoader<ShaderProgram>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
@@ -25,6 +28,15 @@ namespace our {
                 shader->attach(fsPath, GL_FRAGMENT_SHADER);
                 shader->link();
                 assets[name] = shader;
+                std::string instancedPath = desc.value("instancedVs", "");
+                if(!instancedPath.empty()){
+                    auto instanced = new ShaderProgram();
+                    instanced->attach(instancedPath, GL_VERTEX_SHADER);
+                    instanced->attach(fsPath, GL_FRAGMENT_SHADER);
+                    instanced->link();
+                    assets[name + "-instanced"] = instanced;
+                    shader->setInstanced(instanced);
+                }
             }
         }
     };
@@ -22,7 +22,7 @@ namespace our {
         float orthoHeight; // The orthographic height of the camera if it is an orthographic camera
 
         // The ID of this component type is "Camera"
-        static std::string getID() { return "Camera"; }
+        static constexpr std::string_view getID() { return "Camera"; }
 
         // Reads camera parameters from the given json object
         void deserialize(const nlohmann::json& data) override;
@@ -2,9 +2,43 @@
 #include "../ecs/entity.hpp"
 #include "../deserialize-utils.hpp"
 
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
 namespace our {
+
+    // The names of the categories indexed by their ID
+    static std::vector<std::string>& getCollisionCategoryNames() {
+        static std::vector<std::string> names = { "" };
+        return names;
+    }
+
+    CollisionCategory internCollisionCategory(const std::string& name) {
+        auto& names = getCollisionCategoryNames();
+        auto it = std::find(names.begin(), names.end(), name);
+        if(it != names.end()) return (CollisionCategory)(it - names.begin());
+        // If we run out of layer bits, the name is rejected (it gets category 0 like an entity without a category)
+        // instead of sharing the layer bit & the name of an unrelated category
+        if(names.size() == MAX_COLLISION_CATEGORIES){
+            std::cerr << "Too many collision categories (at most " << MAX_COLLISION_CATEGORIES - 1 << " names): \""
+                      << name << "\" is ignored" << std::endl;
+            return 0;
+        }
+        names.push_back(name);
+        return (CollisionCategory)(names.size() - 1);
+    }
+
+    const std::string& getCollisionCategoryName(CollisionCategory category) {
+        return getCollisionCategoryNames()[category];
+    }
+
     void CollisionComponent::deserialize(const nlohmann::json& data){
         if(!data.is_object()) return;
-        collisionType = data.value("collisionType", collisionType);
+        if(data.contains("collisionType")) category = internCollisionCategory(data["collisionType"].get<std::string>());
+        if(data.contains("extents")){
+            halfExtents = data.value("extents", halfExtents);
+            hasExtents = true;
+        }
     }
 }
\ No newline at end of file
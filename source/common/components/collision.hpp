@@ -1,23 +1,43 @@
-
 #pragma once
 
 #include "../ecs/component.hpp"
 
 #include <glm/glm.hpp>
+#include <string>
+#include <cstdint>
 
 namespace our {
 
-    // This component denotes that the MovementSystem will move the owning entity by a certain linear and angular velocity.
-    // This component is added as a simple example for how use the ECS framework to implement logic.
-    // For more information, see "common/systems/movement.hpp"
-    // For a more complex example of how to use the ECS framework, see "free-camera-controller.hpp"
+    // A collision category is a small integer interned from a name (e.g. "penalty") so that the systems compare
+    // integers instead of strings. Each category also has a layer bit ("1 << category") used by the collision layer matrix.
+    typedef uint8_t CollisionCategory;
+    constexpr size_t MAX_COLLISION_CATEGORIES = 32;
+
+    // Returns the category with the given name. A new name gets the next free category (the empty name is category 0).
+    // If all the categories are used, an error is printed and the new name gets category 0.
+    // NOTE: the categories are shared by all the worlds. Call it while loading, not from the systems running on many threads.
+    CollisionCategory internCollisionCategory(const std::string& name);
+    // Returns the name of the given category
+    const std::string& getCollisionCategoryName(CollisionCategory category);
+    // Returns the layer bit of the given category
+    inline uint32_t getCollisionLayer(CollisionCategory category) { return uint32_t(1) << category; }
+
+    // This component denotes that the owning entity can be hit by the player (see "CollisionSystem").
+    // The category decides how the hit is handled and which categories can hit it.
+    // For more information, see "common/systems/collision.hpp"
     class CollisionComponent : public Component {
     public:
-        std::string collisionType = "";
+        CollisionCategory category = 0; // The category interned from "collisionType" when the component is deserialized
+        // The half size of the box around the entity's position. If "hasExtents" is false, the collision system
+        // uses the extents of the category (if the scene config gives them) or the bounds of the entity's mesh.
+        glm::vec3 halfExtents = glm::vec3(0.0f);
+        bool hasExtents = false;
+
         // The ID of this component type is "Collision"
-        static std::string getID() { return "Collision"; }
-        std::string getCollisionType() { return this->collisionType; }
+        static constexpr std::string_view getID() { return "Collision"; }
+        const std::string& getCollisionType() const { return getCollisionCategoryName(category); }
 
+        // Reads "collisionType" & "extents" (half extents) from the given json object
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -8,34 +8,58 @@
 #include "movement.hpp"
 #include "running-object.hpp"
 #include "collision.hpp"
+#include <unordered_map>
+#include <string_view>
+#include <cstdint>
 
 namespace our {
 
+    // Hashes a component type name using 32-bit FNV-1a. Since it is constexpr, the IDs of the components are hashed at compile time.
+    constexpr uint32_t hashComponentName(std::string_view name) {
+        uint32_t hash = 2166136261u;
+        for(char c : name) hash = (hash ^ (uint8_t)c) * 16777619u;
+        return hash;
+    }
+
+    // An entry in the component factory table
+    struct ComponentFactory {
+        std::string_view name; // The ID of the component type (used to reject hash collisions)
+        Component* (*create)(Entity* entity); // Adds a component of this type to the given entity
+    };
+
+    // Creates a factory table entry for the component type T
+    template<typename T>
+    std::pair<const uint32_t, ComponentFactory> componentFactory() {
+        return { hashComponentName(T::getID()), { T::getID(), [](Entity* entity) -> Component* { return entity->addComponent<T>(); } } };
+    }
+
+    // Returns the table of component factories indexed by the hash of their type ID
+    inline const std::unordered_map<uint32_t, ComponentFactory>& getComponentFactories() {
+        //TODO: (Req 8) Add an option to deserialize a "MeshRendererComponent" to the following table
+        // When you create a new type of components, add an entry for it here.
+        static const std::unordered_map<uint32_t, ComponentFactory> factories = {
+            componentFactory<CameraComponent>(),
+            componentFactory<FreeCameraControllerComponent>(),
+            componentFactory<MovementComponent>(),
+            componentFactory<LightComponent>(),
+            componentFactory<MeshRendererComponent>(),
+            componentFactory<RunningObject>(),
+            componentFactory<CollisionComponent>(),
+        };
+        return factories;
+    }
+
     // Given a json object, this function picks and creates a component in the given entity
     // based on the "type" specified in the json object which is later deserialized from the rest of the json object
+    // The "type" is hashed and looked up in the factory table instead of being compared against every component ID
     inline void deserializeComponent(const nlohmann::json& data, Entity* entity){
-        std::string type = data.value("type", "");
-        Component* component = nullptr;
-        //TODO: (Req 8) Add an option to deserialize a "MeshRendererComponent" to the following if-else statement
-        // checking whether a given variable "type" is equal to the ID of a MeshRendererComponent, 
-        // and if so, creating a new instance of the component and assigning it to the variable "component" of the entity.
-        if(type == CameraComponent::getID()){
-            component = entity->addComponent<CameraComponent>();
-        } else if (type == FreeCameraControllerComponent::getID()) {
-            component = entity->addComponent<FreeCameraControllerComponent>();
-        } else if (type == MovementComponent::getID()) {
-            component = entity->addComponent<MovementComponent>();
-        } 
-        else if(type == LightComponent::getID()){
-            component = entity->addComponent<LightComponent>();
-        }
-        else if (type == MeshRendererComponent::getID()) {
-            component = entity->addComponent<MeshRendererComponent>();
-        } else if (type == RunningObject::getID()) {
-            component = entity->addComponent<RunningObject>();
-        } else if(type == CollisionComponent::getID()){
-            component = entity->addComponent<CollisionComponent>();
-        } 
+        auto typeIt = data.find("type");
+        if(typeIt == data.end() || !typeIt->is_string()) return;
+        std::string_view type = typeIt->get_ref<const std::string&>();
+        const auto& factories = getComponentFactories();
+        auto it = factories.find(hashComponentName(type));
+        if(it == factories.end() || it->second.name != type) return;
+        Component* component = it->second.create(entity);
         if(component) component->deserialize(data);
     }
 
@@ -20,7 +20,7 @@ namespace our {
         float speedupFactor = 5.0f; // A multiplier for the positionSensitivity if "Left Shift" is held.
 
         // The ID of this component type is "Free Camera Controller"
-        static std::string getID() { return "Free Camera Controller"; }
+        static constexpr std::string_view getID() { return "Free Camera Controller"; }
 
         // Reads sensitivities & speedupFactor from the given json object
         void deserialize(const nlohmann::json& data) override;
@@ -41,7 +41,7 @@ namespace our {
         void deserialize(const nlohmann::json& data) override;
         
         // identify it is a light component
-        static std::string getID() { return "light"; }
+        static constexpr std::string_view getID() { return "light"; }
 
     };
 
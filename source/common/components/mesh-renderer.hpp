@@ -14,7 +14,7 @@ namespace our {
         Material* material; // The material used to draw the mesh
 
         // The ID of this component type is "Mesh Renderer"
-        static std::string getID() { return "Mesh Renderer"; }
+        static constexpr std::string_view getID() { return "Mesh Renderer"; }
 
         // Receives the mesh & material from the AssetLoader by the names given in the json object
         void deserialize(const nlohmann::json& data) override;
@@ -16,7 +16,7 @@ namespace our {
         glm::vec3 angularVelocity = {0, 0, 0}; // Each frame, the entity should rotate as follows: rotation += angularVelocity * deltaTime
 
         // The ID of this component type is "Movement"
-        static std::string getID() { return "Movement"; }
+        static constexpr std::string_view getID() { return "Movement"; }
 
         // Reads linearVelocity & angularVelocity from the given json object
         void deserialize(const nlohmann::json& data) override;
@@ -14,7 +14,7 @@ namespace our {
     public:
 
         // The ID of this component type is "RunningObject"
-        static std::string getID() { return "RunningObject"; }
+        static constexpr std::string_view getID() { return "RunningObject"; }
 
         void deserialize(const nlohmann::json& data) override;
     };
@@ -0,0 +1,93 @@
+#include "archetype.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    // The number of bytes we aim to fit in a single chunk
+    constexpr size_t CHUNK_BYTES = 16 * 1024;
+
+    // Rounds the offset up to the nearest multiple of the alignment
+    static size_t alignUp(size_t offset, size_t alignment) {
+        return (offset + alignment - 1) / alignment * alignment;
+    }
+
+    Archetype::Archetype(ComponentSignature signature) : signature(signature) {
+        // Collect the types in the order of their IDs
+        for(ComponentTypeID id = 0; id < MAX_COMPONENT_TYPES; id++)
+            if(signature & (ComponentSignature(1) << id))
+                types.push_back(ComponentTypeInfo::get(id));
+        // First, we pick the number of rows such that a chunk is about CHUNK_BYTES
+        size_t rowSize = sizeof(Entity*);
+        chunkAlignment = alignof(Entity*);
+        for(auto type : this->types) {
+            rowSize += type->size;
+            chunkAlignment = std::max(chunkAlignment, type->alignment);
+        }
+        capacity = (uint32_t)std::max<size_t>(1, CHUNK_BYTES / rowSize);
+        // Then we compute where each component array starts inside the chunk (after the entity array)
+        size_t offset = capacity * sizeof(Entity*);
+        for(auto type : this->types) {
+            offset = alignUp(offset, type->alignment);
+            offsets.push_back(offset);
+            offset += capacity * type->size;
+        }
+        chunkSize = alignUp(offset, chunkAlignment);
+    }
+
+    Archetype::~Archetype() {
+        // Destroy any remaining components then free the chunks
+        while(count > 0) remove(count - 1);
+        stats.pageFrees += chunks.size();
+        for(auto& chunk : chunks)
+            ::operator delete(chunk.memory, std::align_val_t(chunkAlignment));
+        chunks.clear();
+    }
+
+    uint32_t Archetype::allocate(Entity* entity) {
+        // If all the chunks are full (or there are no chunks), we add a new chunk
+        if(count == chunks.size() * capacity) {
+            Chunk chunk;
+            chunk.memory = static_cast<std::byte*>(::operator new(chunkSize, std::align_val_t(chunkAlignment)));
+            chunk.count = 0;
+            chunks.push_back(chunk);
+            stats.pageAllocations++;
+        }
+        stats.allocations++;
+        Chunk& chunk = chunks[count / capacity];
+        getEntities(chunk)[chunk.count++] = entity;
+        return count++;
+    }
+
+    Entity* Archetype::remove(uint32_t row) {
+        uint32_t last = count - 1;
+        // Destroy the components of the removed row
+        for(size_t column = 0; column < types.size(); column++)
+            types[column]->destroy(getComponent((int)column, row));
+        Entity* moved = nullptr;
+        // If the removed row is not the last one, move the last row into the hole to keep the rows packed
+        if(row != last) {
+            for(size_t column = 0; column < types.size(); column++) {
+                void* source = getComponent((int)column, last);
+                types[column]->moveConstruct(getComponent((int)column, row), source);
+                types[column]->destroy(source);
+            }
+            moved = getEntity(last);
+            getEntities(chunks[row / capacity])[row % capacity] = moved;
+        }
+        // Finally, shrink the last used chunk
+        chunks[last / capacity].count--;
+        count--;
+        stats.frees++;
+        // We keep one empty chunk as a spare so that an entity moving back and forth around a chunk boundary
+        // doesn't allocate & free a chunk every time. Any other empty chunk is freed.
+        size_t usedChunks = (count + capacity - 1) / capacity;
+        while(chunks.size() > usedChunks + 1) {
+            ::operator delete(chunks.back().memory, std::align_val_t(chunkAlignment));
+            chunks.pop_back();
+            stats.pageFrees++;
+        }
+        return moved;
+    }
+
+}
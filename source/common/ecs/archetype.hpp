@@ -0,0 +1,131 @@
+#pragma once
+
+#include "component.hpp"
+#include "pool.hpp"
+#include <vector>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace our {
+
+    class Entity; // A forward declaration of the Entity Class
+
+    // This struct describes how to construct, move and destroy a component type without knowing its static type.
+    // The archetype storage uses it to place components of any type in raw chunk memory.
+    struct ComponentTypeInfo {
+        ComponentTypeID id;     // The type ID of the component type
+        size_t size;            // sizeof the component type
+        size_t alignment;       // alignof the component type
+        void (*construct)(void* address);                   // Default constructs a component at the given address
+        void (*moveConstruct)(void* destination, void* source); // Move constructs a component from source into destination
+        void (*destroy)(void* address);                     // Calls the destructor of the component at the given address
+        Component* (*toComponent)(void* address);           // Converts the address of a component to a pointer to its Component base
+
+        // Returns the type info of the component with the given type ID (or null if this type was never used)
+        static const ComponentTypeInfo* get(ComponentTypeID id) { return registry()[id]; }
+
+        // Returns the (unique) type info of the component type T
+        template<typename T>
+        static const ComponentTypeInfo& of() {
+            static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
+            static const ComponentTypeInfo info = {
+                componentTypeID<T>(), sizeof(T), alignof(T),
+                [](void* address){ new (address) T(); },
+                [](void* destination, void* source){ new (destination) T(std::move(*static_cast<T*>(source))); },
+                [](void* address){ static_cast<T*>(address)->~T(); },
+                [](void* address) -> Component* { return static_cast<T*>(address); }
+            };
+            static const bool registered = (registry()[info.id] = &info, true);
+            (void)registered;
+            return info;
+        }
+
+    private:
+        // The type infos indexed by their type ID. Every type info registers itself here when it is first requested.
+        static std::array<const ComponentTypeInfo*, MAX_COMPONENT_TYPES>& registry() {
+            static std::array<const ComponentTypeInfo*, MAX_COMPONENT_TYPES> infos{};
+            return infos;
+        }
+    };
+
+    // An archetype stores all the entities that own exactly the same set of component types.
+    // The entities are stored in fixed-size chunks where the components of each type are laid out contiguously,
+    // so a system can walk over a dense array of components instead of following a pointer per entity.
+    // Entities are kept packed: removing a row moves the last row into its place.
+    class Archetype {
+    public:
+        // A chunk is a single block of memory holding "capacity" rows.
+        // The block starts with an array of entity pointers followed by one array per component type.
+        struct Chunk {
+            std::byte* memory;
+            uint32_t count; // The number of used rows in this chunk
+        };
+
+    private:
+        ComponentSignature signature;                // The bitmask of the component types held by this archetype
+        std::vector<const ComponentTypeInfo*> types; // The component types held by this archetype (sorted by type ID)
+        std::vector<size_t> offsets;                 // The byte offset of each component array inside a chunk
+        size_t chunkSize, chunkAlignment;            // The size & alignment of a chunk memory block
+        uint32_t capacity;                           // The number of rows per chunk
+        uint32_t count = 0;                          // The total number of rows in this archetype
+        std::vector<Chunk> chunks;                   // The chunks of this archetype. Only the last used chunk may be partially filled,
+                                                     // and at most one empty chunk is kept after it to avoid freeing & reallocating on churn
+        AllocationStats stats;                       // Counts the chunk allocations (pages) and the row allocations
+
+        // These caches store the archetype we end up in when a component type is added or removed (indexed by type ID)
+        std::array<Archetype*, MAX_COMPONENT_TYPES> addEdges{}, removeEdges{};
+        friend class World;
+
+    public:
+        // Creates an archetype holding the component types whose bits are set in the signature
+        Archetype(ComponentSignature signature);
+        ~Archetype();
+
+        ComponentSignature getSignature() const { return signature; }
+        const std::vector<const ComponentTypeInfo*>& getTypes() const { return types; }
+        uint32_t getCount() const { return count; }
+        uint32_t getCapacity() const { return capacity; }
+        const AllocationStats& getStats() const { return stats; }
+        std::vector<Chunk>& getChunks() { return chunks; }
+
+        // Returns the index of the column storing the given type or -1 if this archetype doesn't contain it
+        // Since the columns are sorted by type ID, the column is the number of types in the signature with a smaller ID
+        int findColumn(ComponentTypeID id) const {
+            if(!(signature & (ComponentSignature(1) << id))) return -1;
+            return (int)componentIndex(signature, id);
+        }
+
+        // Returns the array of entities stored in the given chunk
+        Entity** getEntities(const Chunk& chunk) const {
+            return reinterpret_cast<Entity**>(chunk.memory);
+        }
+        // Returns the array of components stored in the given column of the given chunk
+        template<typename T>
+        T* getColumn(const Chunk& chunk, int column) const {
+            return reinterpret_cast<T*>(chunk.memory + offsets[column]);
+        }
+        // Returns the address of the component in the given column & row
+        void* getComponent(int column, uint32_t row) const {
+            const Chunk& chunk = chunks[row / capacity];
+            return chunk.memory + offsets[column] + (row % capacity) * types[column]->size;
+        }
+        // Returns the entity stored in the given row
+        Entity* getEntity(uint32_t row) const {
+            return getEntities(chunks[row / capacity])[row % capacity];
+        }
+
+        // Reserves a row at the end of the archetype for the given entity and returns its index
+        // NOTE: The components of the new row are not constructed. The caller is responsible for constructing them.
+        uint32_t allocate(Entity* entity);
+        // Destroys the components at the given row, then fills the hole with the last row.
+        // If a row was moved, the entity that owns it is returned so that its row index can be updated. Otherwise, nullptr is returned.
+        Entity* remove(uint32_t row);
+
+        Archetype(const Archetype&) = delete;
+        Archetype& operator=(const Archetype&) = delete;
+    };
+
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "entity.hpp"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+#include <new>
+
+namespace our {
+
+    // The kinds of structural changes that can be recorded in a command buffer
+    // The entities are created before any other command is played back. The other commands keep their recording order
+    // for each entity and the destroyed entities are deleted at the end (see "World::playbackCommands")
+    enum class CommandType {
+        CREATE,
+        SET_PARENT,
+        ADD_COMPONENT,
+        REMOVE_COMPONENT,
+        DESTROY
+    };
+
+    // A command buffer records structural changes (creating & destroying entities, adding & removing components and reparenting)
+    // instead of applying them immediately. The world owns one buffer per thread (see "World::getCommandBuffer"), so systems
+    // running on many threads can record changes without locks. The changes are applied later at a single sync point.
+    class CommandBuffer {
+    public:
+        // The generation given to the handles of the entities created by this buffer before they are played back
+        // No real entity reaches this generation, so these handles never resolve through "World::get".
+        static constexpr uint32_t PENDING_GENERATION = 0xFFFFFFFFu;
+        // The initializer index of an ADD_COMPONENT command that has no initializer
+        static constexpr uint32_t NO_INITIALIZER = 0xFFFFFFFFu;
+
+        // A command only holds plain data. The names & the initializers are kept in the buffer's own storage,
+        // which is emptied (but not freed) by the playback, so recording stops allocating once the buffer reached its usual size.
+        struct Command {
+            CommandType type;
+            uint32_t sequence;     // The order in which the command was recorded in this buffer
+            EntityHandle target;   // The entity the command applies to
+            EntityHandle parent;   // The new parent (only used by SET_PARENT)
+            ComponentTypeID component = 0; // The type of the added or removed component (only used by ADD_COMPONENT & REMOVE_COMPONENT)
+            uint32_t initializer = NO_INITIALIZER; // The index in "initializers" of the function called on the added component (only used by ADD_COMPONENT)
+            uint32_t nameOffset = 0, nameLength = 0; // The name of the new entity in "names" (only used by CREATE)
+        };
+
+    private:
+        // A function given to "addComponent". The callable itself is stored in the payload blocks.
+        struct Initializer {
+            void* data;
+            void (*call)(void* data, Component* component);
+            void (*destroy)(void* data);
+        };
+        // The initializers are constructed in place in blocks of this size (a block never moves, so neither do the callables)
+        static constexpr size_t PAYLOAD_BLOCK_SIZE = 4096;
+        struct PayloadBlock {
+            alignas(std::max_align_t) unsigned char bytes[PAYLOAD_BLOCK_SIZE];
+        };
+
+        std::vector<Command> commands;
+        std::vector<Initializer> initializers;
+        std::vector<std::unique_ptr<PayloadBlock>> blocks; // The blocks are kept after playback to store the next initializers
+        size_t blockIndex = 0, blockOffset = 0; // Where the next initializer is stored
+        std::string names;             // The names of the created entities one after the other
+        uint32_t createCount = 0;      // The number of entities created by this buffer since the last playback
+        std::vector<EntityHandle> created; // The handles of the entities created during playback indexed by their pending handle index
+        friend class World;
+
+        Command& record(CommandType type, EntityHandle target) {
+            Command command;
+            command.type = type;
+            command.sequence = (uint32_t)commands.size();
+            command.target = target;
+            commands.push_back(command);
+            return commands.back();
+        }
+
+        // Returns "size" bytes aligned to "alignment" from the payload blocks (a block is only allocated if the used ones are full)
+        void* allocatePayload(size_t size, size_t alignment) {
+            size_t offset = (blockOffset + alignment - 1) & ~(alignment - 1);
+            if(blockIndex < blocks.size() && offset + size > PAYLOAD_BLOCK_SIZE) {
+                blockIndex++;
+                offset = 0;
+            }
+            if(blockIndex == blocks.size()) blocks.push_back(std::make_unique<PayloadBlock>());
+            blockOffset = offset + size;
+            return blocks[blockIndex]->bytes + offset;
+        }
+
+        // Destroys the initializers then empties the buffer, keeping its memory for the next commands
+        // The entities created by the last playback are kept so that "getCreated" still finds them.
+        void reset() {
+            for(auto& initializer : initializers) initializer.destroy(initializer.data);
+            initializers.clear();
+            commands.clear();
+            names.clear();
+            createCount = 0;
+            blockIndex = blockOffset = 0;
+        }
+
+    public:
+        CommandBuffer() = default;
+        ~CommandBuffer() { reset(); }
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        // Records the creation of an entity and returns a handle that can be used by the next commands of this buffer
+        // NOTE: the handle only refers to the new entity inside this buffer. After playback, use "getCreated" to get its real handle.
+        EntityHandle create(std::string_view name = {}) {
+            EntityHandle handle{ createCount++, PENDING_GENERATION };
+            Command& command = record(CommandType::CREATE, handle);
+            command.nameOffset = (uint32_t)names.size();
+            command.nameLength = (uint32_t)name.size();
+            names += name;
+            return handle;
+        }
+
+        // Records the deletion of an entity
+        void destroy(EntityHandle entity) {
+            record(CommandType::DESTROY, entity);
+        }
+
+        // Records adding a component of type T to the entity
+        template<typename T>
+        void addComponent(EntityHandle entity) {
+            record(CommandType::ADD_COMPONENT, entity).component = ComponentTypeInfo::of<T>().id;
+        }
+
+        // Records adding a component of type T to the entity then calling "initialize(T&)" on it (e.g. to set its data)
+        // The callable is moved into the buffer's payload blocks, so it isn't wrapped in a std::function.
+        template<typename T, typename F>
+        void addComponent(EntityHandle entity, F&& initialize) {
+            using Function = std::decay_t<F>;
+            static_assert(sizeof(Function) <= PAYLOAD_BLOCK_SIZE && alignof(Function) <= alignof(std::max_align_t),
+                "The initializer doesn't fit in a payload block");
+            Command& command = record(CommandType::ADD_COMPONENT, entity);
+            command.component = ComponentTypeInfo::of<T>().id;
+            command.initializer = (uint32_t)initializers.size();
+            void* payload = new (allocatePayload(sizeof(Function), alignof(Function))) Function(std::forward<F>(initialize));
+            initializers.push_back({
+                payload,
+                [](void* data, Component* component){ (*static_cast<Function*>(data))(*static_cast<T*>(component)); },
+                [](void* data){ static_cast<Function*>(data)->~Function(); }
+            });
+        }
+
+        // Records removing the component of type T from the entity
+        template<typename T>
+        void removeComponent(EntityHandle entity) {
+            record(CommandType::REMOVE_COMPONENT, entity).component = componentTypeID<T>();
+        }
+
+        // Records changing the parent of the entity. A default handle makes the entity a root.
+        void setParent(EntityHandle entity, EntityHandle parent) {
+            record(CommandType::SET_PARENT, entity).parent = parent;
+        }
+
+        // Returns the handle of the entity that was created by the "create" call that returned the given pending handle
+        // (valid after playback until the next playback). If a command of the same playback destroyed the new entity,
+        // the handle is already stale, so "World::get" returns null for it.
+        EntityHandle getCreated(EntityHandle handle) const {
+            if(handle.generation != PENDING_GENERATION || handle.index >= created.size()) return {};
+            return created[handle.index];
+        }
+
+        bool empty() const { return commands.empty(); }
+        size_t size() const { return commands.size(); }
+    };
+
+}
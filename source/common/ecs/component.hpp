@@ -2,11 +2,73 @@
 
 #include <json/json.hpp>
 #include <string>
+#include <string_view>
+#include <cstdint>
+#include <atomic>
+#include <cassert>
 
 namespace our {
 
     class Entity; // A forward declaration of the Entity Class
 
+    // Every component type gets a small integer ID which is used as an index into the entity's signature.
+    typedef uint32_t ComponentTypeID;
+    // A signature is a bitmask where bit i is set if the entity has a component whose type ID is i.
+    typedef uint64_t ComponentSignature;
+    // The number of component types is limited by the number of bits in a signature
+    constexpr ComponentTypeID MAX_COMPONENT_TYPES = 64;
+
+    // Returns a new component type ID every time it is called
+    // The counter is atomic since the IDs of two types could be requested by two threads at the same time.
+    inline ComponentTypeID nextComponentTypeID() {
+        static std::atomic<ComponentTypeID> counter{0};
+        ComponentTypeID id = counter.fetch_add(1, std::memory_order_relaxed);
+        assert(id < MAX_COMPONENT_TYPES && "Too many component types for a ComponentSignature");
+        return id;
+    }
+
+    // Returns the type ID of the component type T. The ID is given by the first call.
+    // A function-local static is initialized exactly once on first use, so this is safe to call from anywhere
+    // (even from the static initializers of other translation units, whose order is unspecified).
+    template<typename T>
+    inline ComponentTypeID componentTypeID() {
+        static const ComponentTypeID id = nextComponentTypeID();
+        return id;
+    }
+
+    // The signature bit of the component type T
+    template<typename T>
+    inline ComponentSignature componentTypeBit() { return ComponentSignature(1) << componentTypeID<T>(); }
+
+    // Returns the number of set bits in the signature.
+    // The rank of a type (number of types with a smaller ID) in a signature is used as the index of its component
+    inline uint32_t countComponentTypes(ComponentSignature signature) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (uint32_t)__builtin_popcountll(signature);
+#else
+        signature = signature - ((signature >> 1) & 0x5555555555555555ull);
+        signature = (signature & 0x3333333333333333ull) + ((signature >> 2) & 0x3333333333333333ull);
+        signature = (signature + (signature >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return (uint32_t)((signature * 0x0101010101010101ull) >> 56);
+#endif
+    }
+
+    // Returns the smallest type ID in the signature (the signature must not be empty)
+    inline ComponentTypeID lowestComponentType(ComponentSignature signature) {
+#if defined(__GNUC__) || defined(__clang__)
+        return (ComponentTypeID)__builtin_ctzll(signature);
+#else
+        ComponentTypeID id = 0;
+        while(!(signature & 1)) { signature >>= 1; id++; }
+        return id;
+#endif
+    }
+
+    // Returns the index of the component with the given type ID among the components of the given signature
+    inline uint32_t componentIndex(ComponentSignature signature, ComponentTypeID id) {
+        return countComponentTypes(signature & ((ComponentSignature(1) << id) - 1));
+    }
+
     // A component is a data container that can be added to an entity.
     // The role of the entity in the world is defined by the components it holds.
     // For example, an entity with a camera component specifies that this entity should be used as a camera
@@ -16,9 +78,9 @@ namespace our {
         friend Entity; // The entity is a friend since it is the only one allowed to set itself as an owner of a certain component.
     public:
         // This static method returns a unique string that identifies each type of components
-        // This ID will be used as the key to store a component into the entity's component map 
+        // This ID is the "type" used to deserialize a component (see "component-deserializer.hpp")
         // When you create a new type of components, override this function to return a new unique ID
-        static std::string getID() { return "Component"; }
+        static constexpr std::string_view getID() { return "Component"; }
         // Reads the data of the component from a json object
         // It is abstract since it must be overriden by derived components
         virtual void deserialize(const nlohmann::json& data) = 0;
@@ -1,8 +1,10 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
 #include <glm/gtx/euler_angles.hpp>
+#include <algorithm>
 
 namespace our {
 
@@ -13,23 +15,200 @@ namespace our {
     
     // The getLocalToWorldMatrix function is used to calculate the transformation
     // matrix that converts local coordinates of a 3D object to world coordinates.
-    glm::mat4 Entity::getLocalToWorldMatrix() const {
+    // Since the parent's matrix is cached too, we only multiply our local matrix with the parent's world matrix.
+    const glm::mat4& Entity::getLocalToWorldMatrix() const {
         //TODO: (Req 8) Write this function
-       glm::mat4 localToWorld=this->localTransform.toMat4();
-       Entity * parentPtr= this->parent;
-        // make while loop to all elements till you reach the root   
-        while(parentPtr!=nullptr){
-            localToWorld=  parentPtr->localTransform.toMat4()*localToWorld ;
-            parentPtr=parentPtr->parent;
+        // A clean entity has no dirty ancestor, so its cached matrix is still valid
+        if(!worldDirty.load(std::memory_order_acquire)) return localToWorld;
+        // Resolving the parent first means the hierarchy is resolved from the root down
+        glm::mat4 matrix = parent ? parent->getLocalToWorldMatrix() * getLocalMatrix() : getLocalMatrix();
+        // The first time the matrix changes in a simulation step, the matrix at the start of the step is kept for the interpolation
+        if(previousStep != world->simulationStep){
+            previousLocalToWorld = worldVersion ? localToWorld : matrix; // A new entity has no previous matrix to blend from
+            previousStep = world->simulationStep;
+            world->steppedEntities.push_back(getHandle());
         }
+        localToWorld = matrix;
+        worldVersion++;
+        worldDirty.store(false, std::memory_order_release);
         return localToWorld;
     }
 
+    // The interpolated matrix is only valid in the frame it was computed in and as long as the world matrix didn't change after that
+    const glm::mat4& Entity::getRenderMatrix() const {
+        if(renderFrame == world->renderFrame && renderVersion == worldVersion && !worldDirty.load(std::memory_order_relaxed)) return renderMatrix;
+        return getLocalToWorldMatrix();
+    }
+
+    // Returns the matrix of the local transform, composing it now if the batched pass didn't do it already
+    const glm::mat4& Entity::getLocalMatrix() const {
+        if(!localMatrixReady){
+            localMatrix = localTransform.toMat4();
+            localMatrixReady = true;
+        }
+        return localMatrix;
+    }
+
+    // Marks the local transform as modified, which makes the world matrices of this entity and its descendants dirty
+    void Entity::markTransformDirty(){
+        localMatrixReady = false;
+        invalidateWorldMatrix();
+    }
+
+    // An entity that is already dirty has dirty descendants, so the recursion stops there.
+    // Only the entities that became dirty are recorded, so each one is recorded once until it is resolved.
+    void Entity::invalidateWorldMatrix(){
+        if(worldDirty.exchange(true, std::memory_order_acq_rel)) return;
+        world->recordDirtyTransform(getHandle());
+        for(auto child : children) child->invalidateWorldMatrix();
+    }
+
+    void Entity::setLocalTransform(const Transform& transform){
+        localTransform = transform;
+        markTransformDirty();
+    }
+
+    void Entity::setPosition(const glm::vec3& position){
+        localTransform.position = position;
+        markTransformDirty();
+    }
+
+    void Entity::setPositionRotation(const glm::vec3& position, const glm::vec3& rotation){
+        localTransform.position = position;
+        localTransform.rotation = rotation;
+        markTransformDirty();
+    }
+
+    // Changes the parent of the entity and moves it from the children of its old parent to the children of the new one
+    void Entity::setParent(Entity* parent){
+        if(this->parent == parent) return;
+        if(this->parent){
+            auto& siblings = this->parent->children;
+            siblings.erase(std::find(siblings.begin(), siblings.end(), this));
+        }
+        this->parent = parent;
+        if(parent) parent->children.push_back(this);
+        invalidateWorldMatrix();
+    }
+
+    // Returns true if the components of this entity are stored in archetype chunks
+    bool Entity::usesArchetypes() const {
+        return world->getStorageMode() == StorageMode::ARCHETYPE;
+    }
+
+    // Moves this entity to the archetype that holds its current types plus the given type.
+    // The components we already have are moved to the new row, then the new component is constructed in place.
+    void* Entity::addArchetypeComponent(const ComponentTypeInfo& type){
+        Archetype* target = world->getArchetypeWith(archetype, type);
+        uint32_t targetRow = target->allocate(this);
+        if(archetype){
+            const auto& types = archetype->getTypes();
+            for(size_t column = 0; column < types.size(); column++){
+                int targetColumn = target->findColumn(types[column]->id);
+                types[column]->moveConstruct(target->getComponent(targetColumn, targetRow), archetype->getComponent((int)column, row));
+            }
+            // Removing the old row destroys the moved-from components
+            if(Entity* moved = archetype->remove(row)) moved->row = row;
+        }
+        ComponentSignature oldSignature = signature;
+        archetype = target;
+        row = targetRow;
+        signature = archetype->getSignature();
+        void* address = archetype->getComponent(archetype->findColumn(type.id), row);
+        type.construct(address);
+        notifySignatureChanged(oldSignature);
+        return address;
+    }
+
+    // Moves this entity to the archetype that holds its current types except the type stored in the given column.
+    // The removed component is destroyed alongside the old row.
+    void Entity::removeArchetypeComponent(int column){
+        Archetype* target = world->getArchetypeWithout(archetype, column);
+        uint32_t targetRow = 0;
+        if(target){
+            targetRow = target->allocate(this);
+            const auto& types = archetype->getTypes();
+            for(size_t source = 0; source < types.size(); source++){
+                if((int)source == column) continue;
+                int targetColumn = target->findColumn(types[source]->id);
+                types[source]->moveConstruct(target->getComponent(targetColumn, targetRow), archetype->getComponent((int)source, row));
+            }
+        }
+        if(Entity* moved = archetype->remove(row)) moved->row = row;
+        ComponentSignature oldSignature = signature;
+        archetype = target;
+        row = targetRow;
+        signature = archetype ? archetype->getSignature() : 0;
+        notifySignatureChanged(oldSignature);
+    }
+
+    Component* Entity::addComponentOfType(const ComponentTypeInfo& type){
+        ComponentSignature bit = ComponentSignature(1) << type.id;
+        if(signature & bit){
+            uint32_t index = componentIndex(signature, type.id);
+            return archetype ? type.toComponent(archetype->getComponent((int)index, row)) : components[index];
+        }
+        Component* component;
+        if(usesArchetypes()){
+            component = type.toComponent(addArchetypeComponent(type));
+            component->owner = this;
+            return component;
+        }
+        void* address = allocateListComponent(type);
+        type.construct(address);
+        component = type.toComponent(address);
+        component->owner = this;
+        ComponentSignature oldSignature = signature;
+        signature |= bit;
+        components.insert(components.begin() + componentIndex(signature, type.id), component);
+        notifySignatureChanged(oldSignature);
+        return component;
+    }
+
+    void Entity::deleteComponentOfType(ComponentTypeID id){
+        if((signature & (ComponentSignature(1) << id)) == 0) return;
+        uint32_t index = componentIndex(signature, id);
+        if(archetype) removeArchetypeComponent((int)index);
+        else removeListComponent(index);
+    }
+
+    // Deletes the component at the given index and clears its bit from the signature.
+    // The bit to clear is the index-th set bit of the signature.
+    void Entity::removeListComponent(size_t index){
+        ComponentSignature remaining = signature;
+        for(size_t skipped = 0; skipped < index; skipped++) remaining &= remaining - 1; // Clear the lowest set bit
+        ComponentSignature oldSignature = signature;
+        ComponentTypeID id = lowestComponentType(remaining);
+        signature &= ~(ComponentSignature(1) << id);
+        destroyListComponent(id, components[index]);
+        components.erase(components.begin() + index);
+        notifySignatureChanged(oldSignature);
+    }
+
+    // Gets a slot for a component of the given type from the world's pool
+    void* Entity::allocateListComponent(const ComponentTypeInfo& type){
+        return world->allocateComponent(type);
+    }
+
+    // Destroys the component then returns its slot to the world's pool of its type
+    // Since the pointer could point to a base subobject, we get the address of the complete object before destroying it
+    void Entity::destroyListComponent(ComponentTypeID id, Component* component){
+        void* slot = dynamic_cast<void*>(component);
+        component->~Component();
+        world->deallocateComponent(id, slot);
+    }
+
+    // Tells the world that the signature changed so that it can update its queries
+    void Entity::notifySignatureChanged(ComponentSignature oldSignature){
+        world->onSignatureChanged(this, oldSignature);
+    }
+
     // Deserializes the entity data and components from a json object
     void Entity::deserialize(const nlohmann::json& data){
         if(!data.is_object()) return;
         name = data.value("name", name);
         localTransform.deserialize(data);
+        markTransformDirty();
         if(data.contains("components")){
             if(const auto& components = data["components"]; components.is_array()){
                 for(auto& component: components){
@@ -2,81 +2,194 @@
 
 #include "component.hpp"
 #include "transform.hpp"
-#include <list>
-#include <iterator>
+#include "archetype.hpp"
+#include <vector>
 #include <string>
+#include <atomic>
 #include <glm/glm.hpp>
 
 namespace our {
 
     class World; // A forward declaration of the World Class
 
+    // A handle refers to an entity without owning a pointer to it.
+    // "index" is the entity ID and "generation" counts how many entities used this ID before.
+    // When an entity is deleted, the generation of its ID is incremented, so any handle to it becomes stale
+    // and "World::get" returns null instead of a dangling pointer (even if the ID is reused by a new entity).
+    struct EntityHandle {
+        uint32_t index = 0;
+        uint32_t generation = 0; // Generation 0 is never used by an entity, so a default handle is always invalid
+
+        bool operator==(const EntityHandle& other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const EntityHandle& other) const { return !(*this == other); }
+    };
+
     class Entity{
         World *world; // This defines what world own this entity
-        std::list<Component*> components; // A list of components that are owned by this entity
+        // The components owned by this entity sorted by their type ID (only used if the world doesn't use archetypes)
+        // Since the entity holds at most one component per type, the component of type ID "i" is at "componentIndex(signature, i)"
+        std::vector<Component*> components;
+        ComponentSignature signature = 0; // The bitmask of the component types owned by this entity
+        // If the world uses archetype storage, the components are stored in the row "row" of the archetype "archetype"
+        // An entity without components has no archetype
+        Archetype* archetype = nullptr;
+        uint32_t row = 0;
+        uint32_t id = 0;    // A unique ID among the live entities of the world (reused after the entity is deleted)
+        uint32_t generation = 0; // The generation of the ID when this entity got it (see "EntityHandle")
+        uint32_t index = 0; // The index of this entity in the entities array of the world
+        bool removalPending = false; // True if the entity was marked for removal
+
+        Entity* parent = nullptr; // The parent of the entity. The transform of the entity is relative to its parent.
+                                  // If parent is null, the entity is a root entity (has no parent).
+        std::vector<Entity*> children; // The entities whose parent is this entity (kept up to date by "setParent")
+        Transform localTransform; // The transform of this entity relative to its parent (changed through the setters so it is marked dirty)
+
+        // The cached transformation from the entity's local space to the world space
+        mutable glm::mat4 localToWorld = glm::mat4(1.0f);
+        mutable uint32_t worldVersion = 0; // Incremented whenever "localToWorld" is recomputed
+        // True if "localToWorld" must be recomputed since the local transform of this entity or of an ancestor changed.
+        // Marking an entity dirty marks its descendants too, so a clean entity never has a dirty ancestor and its cached
+        // matrix can be returned without walking up the hierarchy.
+        // It is atomic since systems on different threads could mark two entities that share a descendant.
+        mutable std::atomic<bool> worldDirty{false};
+        // The matrix of "localTransform" if it was already composed by the batched pass in "World::updateTransforms"
+        mutable glm::mat4 localMatrix = glm::mat4(1.0f);
+        mutable bool localMatrixReady = false; // True if "localMatrix" matches "localTransform"
+        uint32_t transformPass = 0; // The pass of "World::updateTransforms" that last processed this entity
+        // The world matrix at the start of the simulation step in which it last changed (see "World::interpolateTransforms")
+        mutable glm::mat4 previousLocalToWorld = glm::mat4(1.0f);
+        mutable uint32_t previousStep = 0; // The simulation step in which "previousLocalToWorld" was recorded
+        // The world matrix blended for rendering. It is only valid in the frame it was computed in and until the world matrix changes.
+        glm::mat4 renderMatrix = glm::mat4(1.0f);
+        uint32_t renderFrame = 0;   // The world's render frame when "renderMatrix" was computed
+        uint32_t renderVersion = 0; // The "worldVersion" from which "renderMatrix" was computed
 
         friend World; // The world is a friend since it is the only class that is allowed to instantiate an entity
         Entity() = default; // The entity constructor is private since only the world is allowed to instantiate an entity
+
+        // Returns the matrix of "localTransform" (composed on demand if it is not ready)
+        const glm::mat4& getLocalMatrix() const;
+        // Tells the entity that "localTransform" was modified so that its world matrix (and its children's) is recomputed
+        void markTransformDirty();
+        // Marks the world matrix of this entity and its descendants dirty. The entities that were clean are recorded
+        // in the world so that the next "World::updateTransforms" only visits them.
+        void invalidateWorldMatrix();
+        // Returns true if the components of this entity are stored in archetype chunks
+        bool usesArchetypes() const;
+        // Moves this entity to the archetype that contains the given type in addition to its current types
+        // then constructs the new component and returns its address
+        void* addArchetypeComponent(const ComponentTypeInfo& type);
+        // Moves this entity to the archetype that contains its current types except the given column
+        void removeArchetypeComponent(int column);
+        // Deletes the component at the given index (only used if the world doesn't use archetypes)
+        void removeListComponent(size_t index);
+        // Gets a slot for a component of the given type from the world's pool (only used if the world doesn't use archetypes)
+        void* allocateListComponent(const ComponentTypeInfo& type);
+        // Destroys the component of the given type ID then returns its slot to the world's pool
+        void destroyListComponent(ComponentTypeID id, Component* component);
+        // Adds the component of the given type (or returns the existing one) like "addComponent<T>" without knowing T
+        // The world uses it to play back the commands, which only record the type ID of the component.
+        Component* addComponentOfType(const ComponentTypeInfo& type);
+        // Deletes the component with the given type ID (if any) like "deleteComponent<T>"
+        void deleteComponentOfType(ComponentTypeID id);
+        // Tells the world that the signature changed so that it can update its queries & its change feeds
+        void notifySignatureChanged(ComponentSignature oldSignature);
     public:
         std::string name; // The name of the entity. It could be useful to refer to an entity by its name
-        Entity* parent;   // The parent of the entity. The transform of the entity is relative to its parent.
-                          // If parent is null, the entity is a root entity (has no parent).
-        Transform localTransform; // The transform of this entity relative to its parent.
 
         World* getWorld() const { return world; } // Returns the world to which this entity belongs
+        uint32_t getID() const { return id; } // Returns the ID of this entity
+        EntityHandle getHandle() const { return { id, generation }; } // Returns a handle that can be checked for staleness later
+        bool isMarkedForRemoval() const { return removalPending; } // Returns true if the entity will be deleted by "deleteMarkedEntities"
+        ComponentSignature getSignature() const { return signature; } // Returns the bitmask of the component types owned by this entity
+        uint32_t getWorldVersion() const { return worldVersion; } // Changes whenever the world matrix is recomputed (read it after "getLocalToWorldMatrix")
 
-        glm::mat4 getLocalToWorldMatrix() const; // Computes and returns the transformation from the entities local space to the world space
+        // Returns the transform of this entity relative to its parent
+        const Transform& getLocalTransform() const { return localTransform; }
+        // Changes the transform (or only the position) of this entity. The world matrices of the entity & its descendants are marked dirty.
+        void setLocalTransform(const Transform& transform);
+        void setPosition(const glm::vec3& position);
+        void setPositionRotation(const glm::vec3& position, const glm::vec3& rotation);
+        // Returns the parent of this entity (null for a root entity) and the entities whose parent is this entity
+        Entity* getParent() const { return parent; }
+        const std::vector<Entity*>& getChildren() const { return children; }
+
+        // Returns the transformation from the entities local space to the world space
+        // The matrix is cached and only recomputed if this entity or one of its ancestors was marked dirty.
+        // NOTE: recomputing a dirty matrix isn't thread safe, so the systems running on many threads should only read
+        // the matrices after "World::updateTransforms" (which leaves every matrix clean).
+        const glm::mat4& getLocalToWorldMatrix() const;
+        // Returns the world matrix as it was last computed without resolving it. It misses the changes made since the last
+        // "World::updateTransforms", but unlike "getLocalToWorldMatrix" it can be read while other threads move entities.
+        const glm::mat4& getCachedLocalToWorldMatrix() const { return localToWorld; }
+        // Returns the matrix used to draw this entity: the world matrix blended between the last two simulation steps
+        // If a transform changed after "World::interpolateTransforms" was called, the current world matrix is returned instead.
+        const glm::mat4& getRenderMatrix() const;
+        // Changes the parent of the entity (null makes it a root entity)
+        void setParent(Entity* parent);
         void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
         
+        // This template method returns true if the entity owns a component of type T
+        template<typename T>
+        bool hasComponent() const {
+            return (signature & componentTypeBit<T>()) != 0;
+        }
+
         // This template method create a component of type T,
         // adds it to the components map and returns a pointer to it 
+        // NOTE: an entity can only hold one component of each type, so we return the existing one if found.
         template<typename T>
         T* addComponent(){
             static_assert(std::is_base_of<Component, T>::value, "T must inherit from Component");
             //TODO: (Req 8) Create an component of type T, set its "owner" to be this entity, then push it into the component's list
             // Don't forget to return a pointer to the new component
 
-            // Create component
-            T* component = new T();
+            if(T* existing = getComponent<T>()) return existing;
+            // If the world uses archetypes, the component is constructed inside the archetype chunk
+            if(usesArchetypes()){
+                T* component = static_cast<T*>(addArchetypeComponent(ComponentTypeInfo::of<T>()));
+                component->owner = this;
+                return component;
+            }
+            // Create component in a slot from the world's pool of T
+            T* component = new (allocateListComponent(ComponentTypeInfo::of<T>())) T();
             // set its "owner" to be this entity
             component->owner = this;
-            // add it to the components
-            this->components.push_back(component);
+            // insert it in the components at the position of its type ID to keep them sorted
+            ComponentSignature oldSignature = signature;
+            signature |= componentTypeBit<T>();
+            this->components.insert(this->components.begin() + componentIndex(signature, componentTypeID<T>()), component);
+            notifySignatureChanged(oldSignature);
             // return it.
             return component;
         }
 
         // This template method searhes for a component of type T and returns a pointer to it
         // If no component of type T was found, it returns a nullptr 
+        // NOTE: The lookup uses the type ID of T, so it only finds components whose type is exactly T.
         template<typename T>
         T* getComponent(){
             //TODO: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
             // Return the component you found, or return null of nothing was found.
 
-            // for loop to all components, and then find the first component that can be dynamically cast to "T*"
-            // then return it, if not found return null.
-            std::list<Component*>::iterator it;
-            // for loop to all components
-            for(it = components.begin(); it != components.end(); it++){
-                // try to find the first component that can be dynamically cast to "T*"
-                T* t = dynamic_cast<T*>(*it);
-                // if found return it
-                if(t)
-                    return t;
-            }
-            // if not found return null.
-            return nullptr;
+            // The signature tells us if the component exists and its rank tells us where it is stored
+            if(!hasComponent<T>()) return nullptr;
+            uint32_t index = componentIndex(signature, componentTypeID<T>());
+            // If the world uses archetypes, the rank is also the column holding the type T
+            if(archetype) return static_cast<T*>(archetype->getComponent((int)index, row));
+            return static_cast<T*>(components[index]);
         }
 
         // This template method dynami and returns a pointer to it
         // If no component of type T was found, it returns a nullptr 
         template<typename T>
         T* getComponent(size_t index){
-            auto it = components.begin();
-            std::advance(it, index);
-            if(it != components.end())
-                return dynamic_cast<T*>(*it);
-            return nullptr;
+            if(archetype){
+                if(index >= archetype->getTypes().size()) return nullptr;
+                return dynamic_cast<T*>(archetype->getTypes()[index]->toComponent(archetype->getComponent((int)index, row)));
+            }
+            if(index >= components.size()) return nullptr;
+            return dynamic_cast<T*>(components[index]);
         }
 
         // This template method searhes for a component of type T and deletes it
@@ -85,29 +198,19 @@ namespace our {
             //TODO: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
             // If found, delete the found component and remove it from the components list
             
-            // for loop to all components, and then find the first component that can be dynamically cast to "T*"
-            // then delete it and erase it from components and return from the function.
-            std::list<Component*>::iterator it;
-            // for loop to all components
-            for(it = components.begin(); it != components.end(); it++){
-                // try to find the first component that can be dynamically cast to "T*"
-                T* t = dynamic_cast<T*>(*it);
-                // if found delete it and erase it from components
-                if(t)
-                    delete *it;
-                    components.erase(it);
-                    return;
-            }
+            if(!hasComponent<T>()) return;
+            uint32_t index = componentIndex(signature, componentTypeID<T>());
+            if(archetype) removeArchetypeComponent((int)index);
+            else removeListComponent(index);
         }
 
         // This template method searhes for a component of type T and deletes it
         void deleteComponent(size_t index){
-            auto it = components.begin();
-            std::advance(it, index);
-            if(it != components.end()) {
-                delete *it;
-                components.erase(it);
+            if(archetype){
+                if(index < archetype->getTypes().size()) removeArchetypeComponent((int)index);
+                return;
             }
+            if(index < components.size()) removeListComponent(index);
         }
 
         // This template method searhes for the given component and deletes it
@@ -116,16 +219,24 @@ namespace our {
             //TODO: (Req 8) Go through the components list and find the given component "component".
             // If found, delete the found component and remove it from the components list
             
+            if(archetype){
+                for(size_t column = 0; column < archetype->getTypes().size(); column++){
+                    Component* stored = archetype->getTypes()[column]->toComponent(archetype->getComponent((int)column, row));
+                    if(stored == static_cast<const Component*>(component)){
+                        removeArchetypeComponent((int)column);
+                        return;
+                    }
+                }
+                return;
+            }
+
             // for loop to all components, and then find given component "component"
             // then delete it and erase it from components and return from the function.
-            std::list<Component*>::iterator it;
-            // for loop to all components
-            for(it = components.begin(); it != components.end(); it++){
-                // try to find given component "component"
-                // if found delete it and erase it from components
-                if(component == *it)
-                    delete *it;
-                    components.erase(it);
+            for(size_t index = 0; index < components.size(); index++){
+                if(static_cast<const Component*>(component) == components[index]){
+                    removeListComponent(index);
+                    return;
+                }
             }
         }
 
@@ -133,16 +244,29 @@ namespace our {
         ~Entity(){
             //TODO: (Req 8) Delete all the components in "components". 
             
+            // If the components are stored in an archetype, we remove our row from it
+            if(archetype){
+                if(Entity* moved = archetype->remove(row)) moved->row = row;
+                archetype = nullptr;
+                signature = 0;
+            }
+
             // for loop to all components, and then delete them
             // then clear all components
-            std::list<Component*>::iterator it;
-            // for loop to all components
-            for(it = components.begin(); it != components.end(); it++){
-                // delete each pointer
-                delete *it;
+            // The components are sorted by type ID, so the type of each component is the next set bit of the signature
+            ComponentSignature remaining = signature;
+            for(auto component : components){
+                // delete each component
+                destroyListComponent(lowestComponentType(remaining), component);
+                remaining &= remaining - 1;
             }
             // clear all components
             components.clear();
+            if(signature){
+                ComponentSignature oldSignature = signature;
+                signature = 0;
+                notifySignatureChanged(oldSignature);
+            }
         }
 
         // Entities should not be copyable
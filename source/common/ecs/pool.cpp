@@ -0,0 +1,48 @@
+#include "pool.hpp"
+
+#include <algorithm>
+#include <new>
+
+namespace our {
+
+    PoolAllocator::PoolAllocator(size_t size, size_t alignment, size_t slotsPerPage) : slotsPerPage(slotsPerPage) {
+        // A free slot stores the pointer to the next free slot, so it must be able to hold a pointer
+        slotAlignment = std::max(alignment, alignof(void*));
+        slotSize = std::max(size, sizeof(void*));
+        slotSize = (slotSize + slotAlignment - 1) / slotAlignment * slotAlignment;
+    }
+
+    PoolAllocator::~PoolAllocator() {
+        for(auto page : pages)
+            ::operator delete(page, std::align_val_t(slotAlignment));
+        stats.pageFrees += pages.size();
+        pages.clear();
+    }
+
+    void* PoolAllocator::allocate() {
+        stats.allocations++;
+        // First, we try to reuse a freed slot
+        if(freeList) {
+            void* slot = freeList;
+            freeList = *static_cast<void**>(slot);
+            stats.reuses++;
+            return slot;
+        }
+        // Otherwise, we take the next unused slot and add a new page if the last one is full
+        if(pages.empty() || nextSlot == slotsPerPage) {
+            pages.push_back(static_cast<std::byte*>(::operator new(slotSize * slotsPerPage, std::align_val_t(slotAlignment))));
+            stats.pageAllocations++;
+            nextSlot = 0;
+        }
+        return pages.back() + slotSize * nextSlot++;
+    }
+
+    void PoolAllocator::deallocate(void* slot) {
+        if(!slot) return;
+        stats.frees++;
+        // Push the slot to the front of the free list
+        *static_cast<void**>(slot) = freeList;
+        freeList = slot;
+    }
+
+}
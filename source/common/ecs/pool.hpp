@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace our {
+
+    // Counters used to check how often the ECS goes to the system allocator
+    // Under steady entity churn, "pageAllocations" should stop growing while "allocations" & "frees" keep going up
+    struct AllocationStats {
+        uint64_t pageAllocations = 0; // The number of blocks of memory requested from the system allocator
+        uint64_t pageFrees = 0;       // The number of blocks of memory returned to the system allocator
+        uint64_t allocations = 0;     // The number of objects allocated from the pool
+        uint64_t reuses = 0;          // The number of allocations that were served by reusing a freed slot
+        uint64_t frees = 0;           // The number of objects returned to the pool
+
+        AllocationStats& operator+=(const AllocationStats& other) {
+            pageAllocations += other.pageAllocations;
+            pageFrees += other.pageFrees;
+            allocations += other.allocations;
+            reuses += other.reuses;
+            frees += other.frees;
+            return *this;
+        }
+    };
+
+    // A pool allocator hands out fixed-size slots carved from large pages.
+    // Freed slots are kept in an intrusive free list (the link is stored inside the free slot itself),
+    // so allocating and freeing are O(1) and never call the system allocator once the pool has grown enough.
+    // The pages are only released when the pool is destroyed.
+    class PoolAllocator {
+        size_t slotSize, slotAlignment; // The size & alignment of each slot
+        size_t slotsPerPage;            // The number of slots in a page
+        std::vector<std::byte*> pages;  // The pages allocated so far
+        size_t nextSlot = 0;            // The index of the first never-used slot in the last page
+        void* freeList = nullptr;       // The head of the list of freed slots
+        AllocationStats stats;
+
+    public:
+        PoolAllocator(size_t size, size_t alignment, size_t slotsPerPage = 64);
+        ~PoolAllocator();
+
+        // Returns an uninitialized slot
+        void* allocate();
+        // Returns the slot to the pool. The object in it must have already been destroyed.
+        void deallocate(void* slot);
+
+        const AllocationStats& getStats() const { return stats; }
+
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+    };
+
+}
@@ -0,0 +1,34 @@
+#include "system-scheduler.hpp"
+
+namespace our {
+
+    void SystemScheduler::add(const std::string& name, SystemAccess access, std::function<void()> update, bool mainThread) {
+        systems.push_back({name, access, std::move(update), mainThread});
+        graphDirty = true;
+    }
+
+    // Every system depends on the systems that were added before it and conflict with it.
+    // Since the dependencies always point from an earlier system to a later one, the graph has no cycles.
+    void SystemScheduler::buildGraph() {
+        graph.clear();
+        for(auto& system : systems)
+            graph.add([&system](){ system.update(); }, system.mainThread);
+        for(size_t after = 0; after < systems.size(); after++)
+            for(size_t before = 0; before < after; before++)
+                if(systems[before].access.conflictsWith(systems[after].access))
+                    graph.precede(before, after);
+        graphDirty = false;
+    }
+
+    void SystemScheduler::run() {
+        if(graphDirty) buildGraph();
+        graph.run();
+    }
+
+    void SystemScheduler::clear() {
+        systems.clear();
+        graph.clear();
+        graphDirty = true;
+    }
+
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "component.hpp"
+#include "transform.hpp"
+#include "../jobs/task-graph.hpp"
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <cassert>
+#include <type_traits>
+
+namespace our {
+
+    // The data that isn't a component (e.g. "Transform" for the entities' local transforms, or a system's own class for the data
+    // it keeps like the grid of "CollisionSystem") gets a resource ID. The resource IDs have their own counter & bitmask,
+    // so they don't use up the component type IDs (which are limited by the bits of a ComponentSignature).
+    typedef uint32_t ResourceID;
+    typedef uint64_t ResourceMask;
+    constexpr ResourceID MAX_RESOURCES = 64;
+
+    // Returns a new resource ID every time it is called
+    inline ResourceID nextResourceID() {
+        static std::atomic<ResourceID> counter{0};
+        ResourceID id = counter.fetch_add(1, std::memory_order_relaxed);
+        assert(id < MAX_RESOURCES && "Too many resources for a ResourceMask");
+        return id;
+    }
+
+    // Returns the resource ID of the type T. The ID is given by the first call.
+    template<typename T>
+    inline ResourceID resourceID() {
+        static const ResourceID id = nextResourceID();
+        return id;
+    }
+
+    // A set of components & resources
+    struct AccessMask {
+        ComponentSignature components = 0;
+        ResourceMask resources = 0;
+
+        AccessMask operator|(const AccessMask& other) const { return { components | other.components, resources | other.resources }; }
+        bool intersects(const AccessMask& other) const { return (components & other.components) != 0 || (resources & other.resources) != 0; }
+    };
+
+    // The data a system reads or writes
+    struct SystemAccess {
+        AccessMask reads;
+        AccessMask writes;
+
+        // Returns true if the two systems can't run at the same time (one writes what the other reads or writes)
+        bool conflictsWith(const SystemAccess& other) const {
+            return writes.intersects(other.reads | other.writes) || other.writes.intersects(reads);
+        }
+    };
+
+    // Returns the mask of a single type: its component bit if it is a component, or its resource bit otherwise
+    template<typename T>
+    AccessMask accessBit() {
+        if constexpr(std::is_base_of_v<Component, T>) return { componentTypeBit<T>(), 0 };
+        else return { 0, ResourceMask(1) << resourceID<T>() };
+    }
+
+    // Returns the mask of the given types. Example: accessOf<MovementComponent, Transform>()
+    template<typename... Ts>
+    AccessMask accessOf() {
+        return (AccessMask{} | ... | accessBit<Ts>());
+    }
+
+    // The system scheduler runs a list of systems every frame using the thread pool.
+    // Each system declares what it reads and writes. Two systems run at the same time unless their accesses conflict,
+    // in which case they run in the order they were added. Inside a system, the work can be split further
+    // using "View::parallelEach" or "parallelFor".
+    class SystemScheduler {
+        struct System {
+            std::string name;
+            SystemAccess access;
+            std::function<void()> update;
+            bool mainThread; // If true, the system is always executed on the thread calling "run" (e.g. it uses OpenGL or the window)
+        };
+        std::vector<System> systems;
+        TaskGraph graph;
+        bool graphDirty = true; // The graph is rebuilt when the list of systems changes
+
+        void buildGraph();
+
+    public:
+        // Adds a system to the schedule. Systems added earlier run first when their accesses conflict.
+        void add(const std::string& name, SystemAccess access, std::function<void()> update, bool mainThread = false);
+        // Runs all the systems and returns when all of them are finished
+        void run();
+        // Removes all the systems
+        void clear();
+    };
+
+}
@@ -0,0 +1,199 @@
+#include "transform-batch.hpp"
+
+#include <cmath>
+
+// The scalar code must not be fused into multiply-adds, otherwise it would round differently from the SIMD code
+#if defined(__clang__) || defined(_MSC_VER)
+#   pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#   pragma GCC optimize("fp-contract=off")
+#endif
+
+// We pick the widest instruction set enabled for this compilation
+// (e.g. using "-mavx" on GCC/Clang or "/arch:AVX" on MSVC enables the AVX kernels)
+#if defined(__AVX__)
+#   define OUR_TRANSFORM_AVX
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OUR_TRANSFORM_SSE2
+#   include <emmintrin.h>
+#endif
+
+namespace our::kernels {
+
+    const char* getSimdPath() {
+#if defined(OUR_TRANSFORM_AVX)
+        return "AVX";
+#elif defined(OUR_TRANSFORM_SSE2)
+        return "SSE2";
+#else
+        return "Scalar";
+#endif
+    }
+
+    void integrateScalar(float* values, const float* rates, float deltaTime, size_t count) {
+        for(size_t index = 0; index < count; index++)
+            values[index] = values[index] + deltaTime * rates[index];
+    }
+
+    void integrate(float* values, const float* rates, float deltaTime, size_t count) {
+        size_t index = 0;
+#if defined(OUR_TRANSFORM_AVX)
+        __m256 dt8 = _mm256_set1_ps(deltaTime);
+        for(; index + 8 <= count; index += 8) {
+            __m256 value = _mm256_loadu_ps(values + index);
+            __m256 rate = _mm256_loadu_ps(rates + index);
+            _mm256_storeu_ps(values + index, _mm256_add_ps(value, _mm256_mul_ps(dt8, rate)));
+        }
+#endif
+#if defined(OUR_TRANSFORM_AVX) || defined(OUR_TRANSFORM_SSE2)
+        __m128 dt4 = _mm_set1_ps(deltaTime);
+        for(; index + 4 <= count; index += 4) {
+            __m128 value = _mm_loadu_ps(values + index);
+            __m128 rate = _mm_loadu_ps(rates + index);
+            _mm_storeu_ps(values + index, _mm_add_ps(value, _mm_mul_ps(dt4, rate)));
+        }
+#endif
+        // The remaining values (or all of them if there is no SIMD support) are integrated one by one
+        integrateScalar(values + index, rates + index, deltaTime, count - index);
+    }
+
+    void integrate(TransformBatch& transforms, const VelocityBatch& velocities, float deltaTime) {
+        for(int axis = 0; axis < 3; axis++) {
+            integrate(transforms.position[axis], velocities.linear[axis], deltaTime, transforms.count);
+            integrate(transforms.rotation[axis], velocities.angular[axis], deltaTime, transforms.count);
+        }
+    }
+
+    // The sines & cosines of the yaw (h), pitch (p) and roll (b) angles of a batch
+    // They are computed with the standard library in both versions of the kernel so that both give the same results.
+    struct EulerSinCos {
+        alignas(32) float ch[TransformBatch::CAPACITY], sh[TransformBatch::CAPACITY];
+        alignas(32) float cp[TransformBatch::CAPACITY], sp[TransformBatch::CAPACITY];
+        alignas(32) float cb[TransformBatch::CAPACITY], sb[TransformBatch::CAPACITY];
+
+        void compute(const TransformBatch& transforms, size_t begin) {
+            for(size_t index = begin; index < transforms.count; index++) {
+                ch[index] = std::cos(transforms.rotation[1][index]);
+                sh[index] = std::sin(transforms.rotation[1][index]);
+                cp[index] = std::cos(transforms.rotation[0][index]);
+                sp[index] = std::sin(transforms.rotation[0][index]);
+                cb[index] = std::cos(transforms.rotation[2][index]);
+                sb[index] = std::sin(transforms.rotation[2][index]);
+            }
+        }
+    };
+
+    // Builds the matrices of the transforms in [begin, count) one at a time
+    // The expressions match glm::yawPitchRoll and are evaluated in the same order as the SIMD version below.
+    static void composeTRSRange(const TransformBatch& t, const EulerSinCos& a, size_t begin, glm::mat4* matrices) {
+        for(size_t i = begin; i < t.count; i++) {
+            float shsp = a.sh[i] * a.sp[i], chsp = a.ch[i] * a.sp[i];
+            float r00 = a.ch[i] * a.cb[i] + shsp * a.sb[i];
+            float r01 = a.sb[i] * a.cp[i];
+            float r02 = -a.sh[i] * a.cb[i] + chsp * a.sb[i];
+            float r10 = -a.ch[i] * a.sb[i] + shsp * a.cb[i];
+            float r11 = a.cb[i] * a.cp[i];
+            float r12 = a.sb[i] * a.sh[i] + chsp * a.cb[i];
+            float r20 = a.sh[i] * a.cp[i];
+            float r21 = -a.sp[i];
+            float r22 = a.ch[i] * a.cp[i];
+            float sx = t.scale[0][i], sy = t.scale[1][i], sz = t.scale[2][i];
+            glm::mat4& m = matrices[i];
+            m[0] = glm::vec4(r00 * sx, r01 * sx, r02 * sx, 0.0f);
+            m[1] = glm::vec4(r10 * sy, r11 * sy, r12 * sy, 0.0f);
+            m[2] = glm::vec4(r20 * sz, r21 * sz, r22 * sz, 0.0f);
+            m[3] = glm::vec4(t.position[0][i], t.position[1][i], t.position[2][i], 1.0f);
+        }
+    }
+
+    void composeTRSScalar(const TransformBatch& transforms, glm::mat4* matrices) {
+        EulerSinCos angles;
+        angles.compute(transforms, 0);
+        composeTRSRange(transforms, angles, 0, matrices);
+    }
+
+#if defined(OUR_TRANSFORM_AVX) || defined(OUR_TRANSFORM_SSE2)
+    // Writes 4 matrices given the rows of each column as 4-wide vectors (lane k belongs to matrix k)
+    static void storeMatrices4(__m128 (&columns)[4][4], glm::mat4* matrices) {
+        for(int column = 0; column < 4; column++) {
+            __m128 r0 = columns[column][0], r1 = columns[column][1], r2 = columns[column][2], r3 = columns[column][3];
+            // After the transpose, r0 holds the column of matrix 0, r1 the column of matrix 1 and so on
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(&matrices[0][column][0], r0);
+            _mm_storeu_ps(&matrices[1][column][0], r1);
+            _mm_storeu_ps(&matrices[2][column][0], r2);
+            _mm_storeu_ps(&matrices[3][column][0], r3);
+        }
+    }
+#endif
+
+    void composeTRS(const TransformBatch& t, glm::mat4* matrices) {
+        EulerSinCos a;
+        a.compute(t, 0);
+        size_t i = 0;
+#if defined(OUR_TRANSFORM_AVX)
+        const __m256 signBit8 = _mm256_set1_ps(-0.0f), zero8 = _mm256_setzero_ps(), one8 = _mm256_set1_ps(1.0f);
+        for(; i + 8 <= t.count; i += 8) {
+            __m256 ch = _mm256_load_ps(a.ch + i), sh = _mm256_load_ps(a.sh + i);
+            __m256 cp = _mm256_load_ps(a.cp + i), sp = _mm256_load_ps(a.sp + i);
+            __m256 cb = _mm256_load_ps(a.cb + i), sb = _mm256_load_ps(a.sb + i);
+            __m256 shsp = _mm256_mul_ps(sh, sp), chsp = _mm256_mul_ps(ch, sp);
+            __m256 r00 = _mm256_add_ps(_mm256_mul_ps(ch, cb), _mm256_mul_ps(shsp, sb));
+            __m256 r01 = _mm256_mul_ps(sb, cp);
+            __m256 r02 = _mm256_add_ps(_mm256_mul_ps(_mm256_xor_ps(sh, signBit8), cb), _mm256_mul_ps(chsp, sb));
+            __m256 r10 = _mm256_add_ps(_mm256_mul_ps(_mm256_xor_ps(ch, signBit8), sb), _mm256_mul_ps(shsp, cb));
+            __m256 r11 = _mm256_mul_ps(cb, cp);
+            __m256 r12 = _mm256_add_ps(_mm256_mul_ps(sb, sh), _mm256_mul_ps(chsp, cb));
+            __m256 r20 = _mm256_mul_ps(sh, cp);
+            __m256 r21 = _mm256_xor_ps(sp, signBit8);
+            __m256 r22 = _mm256_mul_ps(ch, cp);
+            __m256 sx = _mm256_load_ps(t.scale[0] + i), sy = _mm256_load_ps(t.scale[1] + i), sz = _mm256_load_ps(t.scale[2] + i);
+            __m256 columns[4][4] = {
+                { _mm256_mul_ps(r00, sx), _mm256_mul_ps(r01, sx), _mm256_mul_ps(r02, sx), zero8 },
+                { _mm256_mul_ps(r10, sy), _mm256_mul_ps(r11, sy), _mm256_mul_ps(r12, sy), zero8 },
+                { _mm256_mul_ps(r20, sz), _mm256_mul_ps(r21, sz), _mm256_mul_ps(r22, sz), zero8 },
+                { _mm256_load_ps(t.position[0] + i), _mm256_load_ps(t.position[1] + i), _mm256_load_ps(t.position[2] + i), one8 }
+            };
+            // The 8 lanes are written as two groups of 4 matrices
+            __m128 low[4][4], high[4][4];
+            for(int column = 0; column < 4; column++)
+                for(int row = 0; row < 4; row++) {
+                    low[column][row] = _mm256_castps256_ps128(columns[column][row]);
+                    high[column][row] = _mm256_extractf128_ps(columns[column][row], 1);
+                }
+            storeMatrices4(low, matrices + i);
+            storeMatrices4(high, matrices + i + 4);
+        }
+#endif
+#if defined(OUR_TRANSFORM_AVX) || defined(OUR_TRANSFORM_SSE2)
+        const __m128 signBit = _mm_set1_ps(-0.0f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+        for(; i + 4 <= t.count; i += 4) {
+            __m128 ch = _mm_load_ps(a.ch + i), sh = _mm_load_ps(a.sh + i);
+            __m128 cp = _mm_load_ps(a.cp + i), sp = _mm_load_ps(a.sp + i);
+            __m128 cb = _mm_load_ps(a.cb + i), sb = _mm_load_ps(a.sb + i);
+            __m128 shsp = _mm_mul_ps(sh, sp), chsp = _mm_mul_ps(ch, sp);
+            __m128 r00 = _mm_add_ps(_mm_mul_ps(ch, cb), _mm_mul_ps(shsp, sb));
+            __m128 r01 = _mm_mul_ps(sb, cp);
+            __m128 r02 = _mm_add_ps(_mm_mul_ps(_mm_xor_ps(sh, signBit), cb), _mm_mul_ps(chsp, sb));
+            __m128 r10 = _mm_add_ps(_mm_mul_ps(_mm_xor_ps(ch, signBit), sb), _mm_mul_ps(shsp, cb));
+            __m128 r11 = _mm_mul_ps(cb, cp);
+            __m128 r12 = _mm_add_ps(_mm_mul_ps(sb, sh), _mm_mul_ps(chsp, cb));
+            __m128 r20 = _mm_mul_ps(sh, cp);
+            __m128 r21 = _mm_xor_ps(sp, signBit);
+            __m128 r22 = _mm_mul_ps(ch, cp);
+            __m128 sx = _mm_load_ps(t.scale[0] + i), sy = _mm_load_ps(t.scale[1] + i), sz = _mm_load_ps(t.scale[2] + i);
+            __m128 columns[4][4] = {
+                { _mm_mul_ps(r00, sx), _mm_mul_ps(r01, sx), _mm_mul_ps(r02, sx), zero },
+                { _mm_mul_ps(r10, sy), _mm_mul_ps(r11, sy), _mm_mul_ps(r12, sy), zero },
+                { _mm_mul_ps(r20, sz), _mm_mul_ps(r21, sz), _mm_mul_ps(r22, sz), zero },
+                { _mm_load_ps(t.position[0] + i), _mm_load_ps(t.position[1] + i), _mm_load_ps(t.position[2] + i), one }
+            };
+            storeMatrices4(columns, matrices + i);
+        }
+#endif
+        // The remaining transforms (or all of them if there is no SIMD support) are composed one by one
+        composeTRSRange(t, a, i, matrices);
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "transform.hpp"
+#include <glm/glm.hpp>
+#include <cstddef>
+
+namespace our {
+
+    // A batch of transforms stored as a structure of arrays (one array per coordinate)
+    // so that the kernels below can process 4 (SSE) or 8 (AVX) transforms with each instruction.
+    // Systems gather the transforms of a group of entities into a batch, run a kernel, then scatter the results back.
+    struct TransformBatch {
+        static constexpr size_t CAPACITY = 256; // The maximum number of transforms in a batch
+        size_t count = 0;
+        alignas(32) float position[3][CAPACITY];
+        alignas(32) float rotation[3][CAPACITY];
+        alignas(32) float scale[3][CAPACITY];
+
+        // Copies the transform into the given slot of the batch
+        void load(size_t index, const Transform& transform) {
+            for(int axis = 0; axis < 3; axis++) {
+                position[axis][index] = transform.position[axis];
+                rotation[axis][index] = transform.rotation[axis];
+                scale[axis][index] = transform.scale[axis];
+            }
+        }
+        // Copies only the position & rotation of the transform into the given slot (for the kernels that don't read the scale)
+        void loadPositionRotation(size_t index, const Transform& transform) {
+            for(int axis = 0; axis < 3; axis++) {
+                position[axis][index] = transform.position[axis];
+                rotation[axis][index] = transform.rotation[axis];
+            }
+        }
+        // Returns the position & rotation in the given slot
+        glm::vec3 getPosition(size_t index) const { return { position[0][index], position[1][index], position[2][index] }; }
+        glm::vec3 getRotation(size_t index) const { return { rotation[0][index], rotation[1][index], rotation[2][index] }; }
+    };
+
+    // The linear & angular velocities of a batch of entities stored as a structure of arrays
+    struct VelocityBatch {
+        alignas(32) float linear[3][TransformBatch::CAPACITY];
+        alignas(32) float angular[3][TransformBatch::CAPACITY];
+
+        void load(size_t index, const glm::vec3& linearVelocity, const glm::vec3& angularVelocity) {
+            for(int axis = 0; axis < 3; axis++) {
+                linear[axis][index] = linearVelocity[axis];
+                angular[axis][index] = angularVelocity[axis];
+            }
+        }
+    };
+
+    // The kernels exist in a SIMD version (picked at compile time from the enabled instruction sets) and a scalar version.
+    // Both versions execute the same floating point operations in the same order, so they give bit-identical results.
+    // NOTE: To keep this guarantee, "transform-batch.cpp" disables fusing multiply-adds (FP contraction). Fast-math would still break it.
+    namespace kernels {
+        // Returns the name of the instruction set used by the SIMD kernels ("AVX", "SSE2" or "Scalar")
+        const char* getSimdPath();
+
+        // values[i] += deltaTime * rates[i] for every i in [0, count)
+        void integrate(float* values, const float* rates, float deltaTime, size_t count);
+        void integrateScalar(float* values, const float* rates, float deltaTime, size_t count);
+
+        // Integrates the velocities of the batch into its positions & rotations
+        void integrate(TransformBatch& transforms, const VelocityBatch& velocities, float deltaTime);
+
+        // Builds the matrix of every transform in the batch (Translation * Rotation * Scale like "Transform::toMat4")
+        // The rotation uses the same yaw (y), pitch (x) & roll (z) convention as glm::yawPitchRoll.
+        void composeTRS(const TransformBatch& transforms, glm::mat4* matrices);
+        void composeTRSScalar(const TransformBatch& transforms, glm::mat4* matrices);
+    }
+
+}
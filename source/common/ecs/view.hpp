@@ -0,0 +1,128 @@
+#pragma once
+
+#include "entity.hpp"
+#include "../jobs/thread-pool.hpp"
+#include <vector>
+#include <tuple>
+#include <utility>
+
+namespace our {
+
+    // A query is the cached result of looking for the entities that own a certain set of component types.
+    // The world keeps its queries up to date whenever an entity gains or loses a component (or a new archetype is created),
+    // so reading a query never scans the whole world.
+    struct Query {
+        ComponentSignature mask; // The component types required by this query
+        // In the ARCHETYPE storage mode, we only track the matching archetypes since their rows already list their entities
+        std::vector<Archetype*> archetypes;
+        // In the PER_ENTITY storage mode, we track the matching entities
+        // "positions" stores the position (plus one) of each entity in "entities" indexed by the entity ID (0 if it is not in the list)
+        // so that an entity can be removed in O(1) by swapping with the last one
+        std::vector<Entity*> entities;
+        std::vector<uint32_t> positions;
+
+        // Returns true if the given signature contains every type in the mask
+        bool matches(ComponentSignature signature) const { return (signature & mask) == mask; }
+
+        // Adds an entity to the match list
+        void insert(Entity* entity) {
+            if(entity->getID() >= positions.size()) positions.resize(entity->getID() + 1, 0);
+            entities.push_back(entity);
+            positions[entity->getID()] = (uint32_t)entities.size();
+        }
+        // Removes an entity from the match list by moving the last entity into its place
+        void erase(Entity* entity) {
+            if(entity->getID() >= positions.size() || positions[entity->getID()] == 0) return;
+            uint32_t index = positions[entity->getID()] - 1;
+            positions[entity->getID()] = 0;
+            if(index != entities.size() - 1){
+                entities[index] = entities.back();
+                positions[entities[index]->getID()] = index + 1;
+            }
+            entities.pop_back();
+        }
+    };
+
+    // A view is a lightweight handle to a query that iterates over the entities owning every component type in Ts
+    // It is returned by "World::view" and should not outlive the world.
+    template<typename... Ts>
+    class View {
+        const Query* query;
+
+        // Calls "function" for every row of the given chunk passing the entity and a reference to each of its components of types Ts
+        template<typename F, size_t... I>
+        static void eachInChunk(Archetype* archetype, const Archetype::Chunk& chunk, const int* columns, F& function, std::index_sequence<I...>) {
+            Entity** owners = archetype->getEntities(chunk);
+            std::tuple<Ts*...> arrays{ archetype->getColumn<Ts>(chunk, columns[I])... };
+            for(uint32_t index = 0; index < chunk.count; index++)
+                function(owners[index], std::get<I>(arrays)[index]...);
+        }
+
+    public:
+        explicit View(const Query* query) : query(query) {}
+
+        // Returns the number of entities matching this view
+        size_t size() const {
+            size_t count = query->entities.size();
+            for(Archetype* archetype : query->archetypes) count += archetype->getCount();
+            return count;
+        }
+        bool empty() const { return size() == 0; }
+
+        // Calls "function(Entity*, Ts&...)" for every entity that owns a component of every type in Ts
+        // In the ARCHETYPE storage mode, this walks over the dense component arrays of every matching archetype chunk
+        // WARNING: Don't add or remove components or entities inside "function". Use "markForRemoval" instead of deleting entities.
+        template<typename F>
+        void each(F&& function) const {
+            for(Archetype* archetype : query->archetypes){
+                int columns[] = { archetype->findColumn(componentTypeID<Ts>())... };
+                for(const auto& chunk : archetype->getChunks())
+                    eachInChunk(archetype, chunk, columns, function, std::index_sequence_for<Ts...>{});
+            }
+            for(Entity* entity : query->entities)
+                function(entity, *entity->getComponent<Ts>()...);
+        }
+
+        // Same as "each" but the entities are split among the threads of the thread pool
+        // In the ARCHETYPE storage mode, every chunk is a unit of work. Otherwise, the entities are split in ranges of "grainSize".
+        // WARNING: "function" is called from many threads at the same time, so it should only write to the entity it is given.
+        template<typename F>
+        void parallelEach(F&& function, size_t grainSize = 256) const {
+            ThreadPool& pool = ThreadPool::get();
+            for(Archetype* archetype : query->archetypes){
+                int columns[] = { archetype->findColumn(componentTypeID<Ts>())... };
+                auto& chunks = archetype->getChunks();
+                pool.parallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end){
+                    for(size_t chunk = begin; chunk < end; chunk++)
+                        eachInChunk(archetype, chunks[chunk], columns, function, std::index_sequence_for<Ts...>{});
+                });
+            }
+            const auto& entities = query->entities;
+            pool.parallelFor(0, entities.size(), grainSize, [&](size_t begin, size_t end){
+                for(size_t index = begin; index < end; index++)
+                    function(entities[index], *entities[index]->getComponent<Ts>()...);
+            });
+        }
+
+        // Same as "parallelEach" but "function(Entity* const* entities, size_t count)" receives whole ranges of matching entities
+        // so that it can process them in batches (e.g. with the SIMD kernels in "transform-batch.hpp")
+        // In the ARCHETYPE storage mode, every chunk is a range. Otherwise, the entities are split in ranges of at least "grainSize".
+        template<typename F>
+        void parallelEachRange(F&& function, size_t grainSize = 256) const {
+            ThreadPool& pool = ThreadPool::get();
+            for(Archetype* archetype : query->archetypes){
+                auto& chunks = archetype->getChunks();
+                pool.parallelFor(0, chunks.size(), 1, [&](size_t begin, size_t end){
+                    for(size_t chunk = begin; chunk < end; chunk++)
+                        if(chunks[chunk].count > 0)
+                            function(archetype->getEntities(chunks[chunk]), (size_t)chunks[chunk].count);
+                });
+            }
+            const auto& entities = query->entities;
+            pool.parallelFor(0, entities.size(), grainSize, [&](size_t begin, size_t end){
+                function(entities.data() + begin, end - begin);
+            });
+        }
+    };
+
+}
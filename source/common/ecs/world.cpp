@@ -1,7 +1,356 @@
 #include "world.hpp"
+#include "transform-batch.hpp"
+
+#include <algorithm>
 
 namespace our {
 
+World::World() {
+  static std::atomic<uint64_t> instanceCounter{0};
+  instance = ++instanceCounter;
+}
+
+// Changes how the components of the entities are stored
+// Since the components of the existing entities are not migrated, this is ignored if the world is not empty
+void World::setStorageMode(StorageMode mode) {
+  if (!entities.empty())
+    return;
+  storageMode = mode;
+}
+
+// Returns the archetype holding exactly the component types in the signature
+Archetype *World::getArchetype(ComponentSignature signature) {
+  if (auto it = archetypes.find(signature); it != archetypes.end())
+    return it->second;
+  Archetype *archetype = new Archetype(signature);
+  archetypes[signature] = archetype;
+  archetypeList.push_back(archetype);
+  // The queries that match the new archetype start tracking it
+  for (auto query : queryList)
+    if (query->matches(signature))
+      query->archetypes.push_back(archetype);
+  return archetype;
+}
+
+// Returns the query matching the given mask
+// A new query is filled by a single scan over the archetypes (or the entities)
+// then it is kept up to date by "getArchetype" and "onSignatureChanged"
+const Query *World::getQuery(ComponentSignature mask) {
+  if (auto it = queries.find(mask); it != queries.end())
+    return it->second;
+  Query *query = new Query();
+  query->mask = mask;
+  for (auto archetype : archetypeList)
+    if (query->matches(archetype->getSignature()))
+      query->archetypes.push_back(archetype);
+  if (storageMode == StorageMode::PER_ENTITY)
+    for (auto entity : entities)
+      if (query->matches(entity->getSignature()))
+        query->insert(entity);
+  queries[mask] = query;
+  queryList.push_back(query);
+  return query;
+}
+
+// Returns the data of the calling thread
+// Each thread remembers the last data it got, so the lock is only taken the
+// first time a thread uses a world
+World::ThreadData &World::getThreadData() {
+  thread_local uint64_t cachedInstance = 0;
+  thread_local ThreadData *cachedData = nullptr;
+  if (cachedInstance == instance)
+    return *cachedData;
+  std::lock_guard<std::mutex> lock(threadsMutex);
+  std::thread::id thread = std::this_thread::get_id();
+  ThreadData *data = nullptr;
+  for (auto &candidate : threads)
+    if (candidate->thread == thread)
+      data = candidate.get();
+  if (!data) {
+    threads.push_back(std::make_unique<ThreadData>());
+    data = threads.back().get();
+    data->thread = thread;
+  }
+  cachedInstance = instance;
+  cachedData = data;
+  return *data;
+}
+
+// Returns the command buffer of the calling thread
+CommandBuffer &World::getCommandBuffer() { return getThreadData().commands; }
+
+// Applies the recorded commands of all the buffers in one batch
+void World::playbackCommands() {
+  // Returns the entity referred to by a handle recorded in the given buffer
+  auto resolve = [this](CommandBuffer &buffer, EntityHandle handle) -> Entity * {
+    if (handle.generation == CommandBuffer::PENDING_GENERATION)
+      handle = buffer.getCreated(handle);
+    Entity *entity = get(handle);
+    return (entity && !entity->isMarkedForRemoval()) ? entity : nullptr;
+  };
+
+  // First, we create the new entities so that the other commands can refer to
+  // them
+  for (auto &data : threads) {
+    CommandBuffer &buffer = data->commands;
+    buffer.created.clear();
+    for (auto &command : buffer.commands) {
+      if (command.type != CommandType::CREATE)
+        continue;
+      Entity *entity = add();
+      entity->name.assign(buffer.names, command.nameOffset, command.nameLength);
+      buffer.created.push_back(entity->getHandle());
+    }
+  }
+
+  // Then we resolve the targets of the remaining commands and sort them by
+  // entity. The commands of each entity keep their recording order (the
+  // buffers of different threads are ordered by their index)
+  pendingCommands.clear();
+  for (uint32_t index = 0; index < threads.size(); index++) {
+    CommandBuffer &buffer = threads[index]->commands;
+    for (auto &command : buffer.commands) {
+      if (command.type == CommandType::CREATE)
+        continue;
+      if (Entity *target = resolve(buffer, command.target))
+        pendingCommands.push_back(
+            {command.type, target->id, index, command.sequence, target});
+    }
+  }
+  std::sort(pendingCommands.begin(), pendingCommands.end(),
+            [](const PendingCommand &a, const PendingCommand &b) {
+              if (a.entityID != b.entityID)
+                return a.entityID < b.entityID;
+              if (a.buffer != b.buffer)
+                return a.buffer < b.buffer;
+              return a.sequence < b.sequence;
+            });
+
+  // Now we apply them. Destroying only marks the entity (the marked entities
+  // are deleted at the end) so the resolved targets stay valid until the end.
+  // The commands recorded after the destruction of their entity are dropped.
+  for (auto &pending : pendingCommands) {
+    if (pending.target->isMarkedForRemoval())
+      continue;
+    CommandBuffer &buffer = threads[pending.buffer]->commands;
+    CommandBuffer::Command &command = buffer.commands[pending.sequence];
+    switch (pending.type) {
+    case CommandType::SET_PARENT:
+      if (command.parent == EntityHandle{})
+        pending.target->setParent(nullptr);
+      else if (Entity *parent = resolve(buffer, command.parent))
+        pending.target->setParent(parent);
+      break;
+    case CommandType::ADD_COMPONENT: {
+      Component *component = pending.target->addComponentOfType(
+          *ComponentTypeInfo::get(command.component));
+      if (command.initializer != CommandBuffer::NO_INITIALIZER) {
+        auto &initializer = buffer.initializers[command.initializer];
+        initializer.call(initializer.data, component);
+      }
+      break;
+    }
+    case CommandType::REMOVE_COMPONENT:
+      pending.target->deleteComponentOfType(command.component);
+      break;
+    case CommandType::DESTROY:
+      markForRemoval(pending.target);
+      break;
+    default:
+      break;
+    }
+  }
+  deleteMarkedEntities();
+
+  // Finally, the buffers are cleared (keeping their memory for the next frame)
+  for (auto &data : threads)
+    data->commands.reset();
+}
+
+// Updates the match lists of the queries after the signature of the given
+// entity changed. Only the queries whose result changed are touched.
+void World::onSignatureChanged(Entity *entity, ComponentSignature oldSignature) {
+  ComponentSignature signature = entity->getSignature();
+  for (auto &feed : feeds)
+    if (feed->matches(oldSignature) != feed->matches(signature))
+      feed->changes.push_back(entity->getHandle());
+  // The queries of the ARCHETYPE storage mode track the archetypes instead
+  if (storageMode != StorageMode::PER_ENTITY)
+    return;
+  for (auto query : queryList) {
+    bool matched = query->matches(oldSignature);
+    bool matches = query->matches(signature);
+    if (matches && !matched)
+      query->insert(entity);
+    else if (matched && !matches)
+      query->erase(entity);
+  }
+}
+
+// Removes the entity from the entities array by moving the last entity into its
+// place, then destroys it and returns its slot & ID to be reused
+// The entity is removed from the children of its parent and its own children
+// become root entities (so no entity is left pointing to a deleted parent)
+void World::destroy(Entity *entity) {
+  recordChange(entity, entity->signature);
+  entity->setParent(nullptr);
+  for (auto child : entity->children) {
+    child->parent = nullptr;
+    child->invalidateWorldMatrix();
+  }
+  entity->children.clear();
+  Entity *last = entities.back();
+  entities[entity->index] = last;
+  last->index = entity->index;
+  entities.pop_back();
+  uint32_t id = entity->id;
+  entity->~Entity();
+  entityPool.deallocate(entity);
+  // Any handle to the deleted entity becomes stale
+  slots[id].entity = nullptr;
+  slots[id].generation++;
+  freeIDs.push_back(id);
+}
+
+// Returns an uninitialized slot from the pool of the given component type
+void *World::allocateComponent(const ComponentTypeInfo &type) {
+  PoolAllocator *&pool = componentPools[type.id];
+  if (!pool)
+    pool = new PoolAllocator(type.size, type.alignment);
+  return pool->allocate();
+}
+
+// Returns the slot of a destroyed component to the pool of its type
+void World::deallocateComponent(ComponentTypeID id, void *slot) {
+  componentPools[id]->deallocate(slot);
+}
+
+// Sums the allocation counters of all the pools & archetypes of this world
+AllocationStats World::getAllocationStats() const {
+  AllocationStats stats = entityPool.getStats();
+  stats += releasedStats;
+  for (auto pool : componentPools)
+    if (pool)
+      stats += pool->getStats();
+  for (auto archetype : archetypeList)
+    stats += archetype->getStats();
+  return stats;
+}
+
+// Collects the entities recorded as dirty by all the threads, composes their
+// local matrices in batches (spread over the thread pool) then resolves their
+// world matrices from the roots down
+void World::updateTransforms() {
+  transformPass++;
+  changedTransforms.clear();
+  for (auto &data : threads) {
+    for (EntityHandle handle : data->dirtyTransforms) {
+      // A deleted entity has nothing to update and an entity that was marked
+      // again after being resolved is only processed once
+      Entity *entity = get(handle);
+      if (!entity || entity->transformPass == transformPass)
+        continue;
+      entity->transformPass = transformPass;
+      changedTransforms.push_back(entity);
+    }
+    data->dirtyTransforms.clear();
+  }
+  parallelFor(0, changedTransforms.size(), TransformBatch::CAPACITY,
+              [this](size_t begin, size_t end) {
+                TransformBatch batch;
+                Entity *owners[TransformBatch::CAPACITY];
+                glm::mat4 matrices[TransformBatch::CAPACITY];
+                size_t index = begin;
+                while (index < end) {
+                  batch.count = 0;
+                  for (; index < end && batch.count < TransformBatch::CAPACITY;
+                       index++) {
+                    Entity *entity = changedTransforms[index];
+                    if (entity->localMatrixReady)
+                      continue;
+                    owners[batch.count] = entity;
+                    batch.load(batch.count++, entity->localTransform);
+                  }
+                  kernels::composeTRS(batch, matrices);
+                  for (size_t slot = 0; slot < batch.count; slot++) {
+                    owners[slot]->localMatrix = matrices[slot];
+                    owners[slot]->localMatrixReady = true;
+                  }
+                }
+              });
+  // Each entity resolves its parent first, so this pass only does the matrix
+  // products along the dirty branches of the hierarchy
+  for (auto entity : changedTransforms)
+    entity->getLocalToWorldMatrix();
+  // The systems watching the moved entities are told about the new matrices
+  if (!feeds.empty())
+    for (auto entity : changedTransforms)
+      recordChange(entity, entity->signature);
+}
+
+// The previous matrices must be the fully resolved world matrices, so the
+// pending transform changes are applied first. The previous matrix of an
+// entity is only recorded when its world matrix changes during the new step
+// (see "Entity::getLocalToWorldMatrix"), so nothing is copied for the entities
+// that don't move.
+void World::beginSimulationStep() {
+  updateTransforms();
+  simulationStep++;
+  steppedEntities.clear();
+}
+
+// Blends the matrices component-wise. Since a step is short, the rotation
+// barely changes between both matrices so the blend stays close to a rigid
+// transform. The render matrices of the other entities are invalidated by
+// advancing the render frame, so they fall back to their world matrix.
+void World::interpolateTransforms(float alpha) {
+  updateTransforms();
+  renderFrame++;
+  parallelFor(0, steppedEntities.size(), 1024, [&](size_t begin, size_t end) {
+    for (size_t index = begin; index < end; index++) {
+      Entity *entity = get(steppedEntities[index]);
+      if (!entity || entity->previousStep != simulationStep ||
+          entity->previousLocalToWorld == entity->localToWorld)
+        continue;
+      entity->renderMatrix =
+          entity->previousLocalToWorld +
+          (entity->localToWorld - entity->previousLocalToWorld) * alpha;
+      entity->renderFrame = renderFrame;
+      entity->renderVersion = entity->worldVersion;
+    }
+  });
+}
+
+// Returns the archetype holding the types of "archetype" plus the given type
+// The result is cached in the archetype so that the next lookup is a single
+// array access
+Archetype *World::getArchetypeWith(Archetype *archetype,
+                                   const ComponentTypeInfo &type) {
+  ComponentSignature bit = ComponentSignature(1) << type.id;
+  if (!archetype)
+    return getArchetype(bit);
+  if (Archetype *target = archetype->addEdges[type.id])
+    return target;
+  Archetype *target = getArchetype(archetype->getSignature() | bit);
+  archetype->addEdges[type.id] = target;
+  return target;
+}
+
+// Returns the archetype holding the types of "archetype" except the type in
+// the given column
+Archetype *World::getArchetypeWithout(Archetype *archetype, int column) {
+  ComponentTypeID id = archetype->getTypes()[column]->id;
+  if (Archetype *target = archetype->removeEdges[id])
+    return target;
+  ComponentSignature signature =
+      archetype->getSignature() & ~(ComponentSignature(1) << id);
+  if (signature == 0)
+    return nullptr;
+  Archetype *target = getArchetype(signature);
+  archetype->removeEdges[id] = target;
+  return target;
+}
+
 // This will deserialize a json array of entities and add the new entities to
 // the current world If parent pointer is not null, the new entities will be
 // have their parent set to that given pointer If any of the entities has
@@ -16,7 +365,7 @@ void World::deserialize(const nlohmann::json &data, Entity *parent) {
     // Create an entity
     Entity *entity = add();
     // make its parent "parent"
-    entity->parent = parent;
+    entity->setParent(parent);
     // call its deserialize with "entityData".
     entity->deserialize(entityData);
     if (entityData.contains("children")) {
@@ -1,18 +1,192 @@
 #pragma once
 
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "entity.hpp"
+#include "view.hpp"
+#include "pool.hpp"
+#include "command-buffer.hpp"
 
 namespace our {
 
+    // This enum defines how the world stores the components of its entities
+    // PER_ENTITY: every component is allocated on its own and each entity keeps a list of pointers to its components
+    // ARCHETYPE: entities owning the same set of component types are grouped into archetype chunks,
+    //            where the components of each type are stored contiguously (see "archetype.hpp")
+    enum class StorageMode {
+        PER_ENTITY,
+        ARCHETYPE
+    };
+
+    // The entities matching a mask whose data changed, recorded for a system that keeps its own copy of that data (see "World::watch")
+    // An entity is recorded when its world matrix changes, when it starts or stops matching the mask, when it is marked for removal
+    // and when it is deleted. The same entity can be recorded more than once, and a recorded handle could be stale by the time
+    // the system reads it, so the system should look each entity up again (using "World::get").
+    struct ChangeFeed {
+        ComponentSignature mask;
+        std::vector<EntityHandle> changes; // Cleared by the system after it processed them
+
+        bool matches(ComponentSignature signature) const { return (signature & mask) == mask; }
+    };
+
     // This class holds a set of entities
     class World {
-        std::unordered_set<Entity*> entities; // These are the entities held by this world
-        std::unordered_set<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
-                                                      // when deleteMarkedEntities is called
+        std::vector<Entity*> entities; // These are the entities held by this world (each entity knows its index in this array)
+        std::vector<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
+                                               // when deleteMarkedEntities is called
+        // The entities and the components (in the PER_ENTITY storage mode) are allocated from pools owned by the world
+        // so that spawning & despawning entities reuses the freed slots instead of calling new & delete
+        PoolAllocator entityPool{sizeof(Entity), alignof(Entity)};
+        std::array<PoolAllocator*, MAX_COMPONENT_TYPES> componentPools{}; // One pool per component type ID (created on first use)
+        // Every live entity has a unique ID which is its index in "slots". The IDs of the deleted entities are reused
+        // (the most recently freed first, so the IDs given to the entities are the same on every run).
+        struct EntitySlot {
+            Entity* entity = nullptr; // The entity currently using this ID (null if the ID is free)
+            uint32_t generation = 1;  // Incremented when the entity using this ID is deleted
+        };
+        std::vector<EntitySlot> slots;
+        std::vector<uint32_t> freeIDs;
+        AllocationStats releasedStats; // The counters of the archetypes that were deleted by "clear"
+        // The entities whose world matrix changed since the last "updateTransforms" (each one is processed once per pass)
+        std::vector<Entity*> changedTransforms;
+        uint32_t transformPass = 0; // The number of times "updateTransforms" was called
+        uint32_t simulationStep = 0; // The number of times "beginSimulationStep" was called
+        // The entities whose world matrix changed during the current simulation step (they are the only ones to interpolate)
+        std::vector<EntityHandle> steppedEntities;
+        uint32_t renderFrame = 1; // The number of times "interpolateTransforms" was called (plus one so that a new entity has no valid render matrix)
+        StorageMode storageMode = StorageMode::PER_ENTITY; // How the components of the entities are stored
+        // The archetypes of this world (only used in the ARCHETYPE storage mode) indexed by their component signature
+        std::unordered_map<ComponentSignature, Archetype*> archetypes;
+        std::vector<Archetype*> archetypeList; // The same archetypes stored in an array for fast iteration
+
+        // The cached queries of this world indexed by their mask (see "view")
+        std::unordered_map<ComponentSignature, Query*> queries;
+        std::vector<Query*> queryList; // The same queries stored in an array for fast iteration
+        // The change feeds requested by the systems (see "watch"). They live as long as the world since the systems keep pointers to them.
+        std::vector<std::unique_ptr<ChangeFeed>> feeds;
+
+        // The data that each thread records into without locks: its command buffer and the entities whose transform it marked dirty
+        struct ThreadData {
+            std::thread::id thread;
+            CommandBuffer commands;
+            std::vector<EntityHandle> dirtyTransforms;
+        };
+        // The data of the threads that used this world (see "getThreadData")
+        std::vector<std::unique_ptr<ThreadData>> threads;
+        std::mutex threadsMutex;
+        uint64_t instance; // A number that is unique to this world instance (used to cache the data of each thread)
+        // A command waiting to be played back, resolved to its target entity and sorted by (entity, buffer, sequence)
+        struct PendingCommand {
+            CommandType type;
+            uint32_t entityID;
+            uint32_t buffer;
+            uint32_t sequence;
+            Entity* target;
+        };
+        std::vector<PendingCommand> pendingCommands; // Kept between frames to reuse its memory
+
+        // Returns the query matching the given mask (the query is created and filled if it doesn't exist)
+        const Query* getQuery(ComponentSignature mask);
+
+        // Removes the entity from the entities array, destroys it and returns its memory to the pool
+        void destroy(Entity* entity);
+
+        // Returns the data of the calling thread (created the first time the thread uses this world)
+        ThreadData& getThreadData();
+        // Records that the world matrix of the entity became dirty (called by the entity from any thread)
+        void recordDirtyTransform(EntityHandle handle) { getThreadData().dirtyTransforms.push_back(handle); }
+
+        // Records the entity in the feeds matching the given signature
+        void recordChange(const Entity* entity, ComponentSignature signature) {
+            for(auto& feed : feeds)
+                if(feed->matches(signature)) feed->changes.push_back(entity->getHandle());
+        }
+
+        friend Entity; // The entities record their dirty transforms & their previous matrices in the world
+
     public:
 
-        World() = default;
+        World();
+
+        // Returns how the components of the entities are stored
+        StorageMode getStorageMode() const { return storageMode; }
+        // Changes how the components of the entities are stored
+        // WARNING: This must be called while the world is empty (before adding or deserializing any entity)
+        void setStorageMode(StorageMode mode);
+
+        // Returns the archetype holding exactly the component types in the signature (the archetype is created if it doesn't exist)
+        Archetype* getArchetype(ComponentSignature signature);
+        // Returns the archetype holding the types of "archetype" plus the given type (archetype could be null)
+        Archetype* getArchetypeWith(Archetype* archetype, const ComponentTypeInfo& type);
+        // Returns the archetype holding the types of "archetype" except the type in the given column (null if no types remain)
+        Archetype* getArchetypeWithout(Archetype* archetype, int column);
+
+        // Returns a view over the entities that own a component of every type in Ts
+        // The first call for a set of types scans the world once. After that, the match list is kept up to date
+        // as components are added or removed so iterating a view only touches the matching entities.
+        // Example: world->view<CameraComponent>().each([](Entity* entity, CameraComponent& camera){ ... });
+        template<typename... Ts>
+        View<Ts...> view() {
+            static_assert(sizeof...(Ts) > 0, "view needs at least one component type");
+            return View<Ts...>(getQuery((componentTypeBit<Ts>() | ...)));
+        }
+
+        // Returns the feed of the changes to the entities that own a component of every type in Ts (the feed is created if it doesn't exist)
+        // The changes are recorded from the thread that updates the transforms & plays back the commands, so read them from that thread
+        // or from a system that doesn't run at the same time as a structural change.
+        // Example: for(EntityHandle handle : feed->changes) { Entity* entity = world->get(handle); ... } feed->changes.clear();
+        template<typename... Ts>
+        ChangeFeed* watch() {
+            static_assert(sizeof...(Ts) > 0, "watch needs at least one component type");
+            ComponentSignature mask = (componentTypeBit<Ts>() | ...);
+            for(auto& feed : feeds)
+                if(feed->mask == mask) return feed.get();
+            feeds.push_back(std::make_unique<ChangeFeed>(ChangeFeed{mask, {}}));
+            return feeds.back().get();
+        }
+
+        // Returns an uninitialized slot big enough for a component of the given type (used by the entity in the PER_ENTITY storage mode)
+        void* allocateComponent(const ComponentTypeInfo& type);
+        // Returns the slot of a destroyed component of the given type to its pool
+        void deallocateComponent(ComponentTypeID id, void* slot);
+        // Returns the sum of the allocation counters of the entity pool, the component pools and the archetype chunks
+        AllocationStats getAllocationStats() const;
+
+        // Recomputes the world matrices of the entities whose transform (or an ancestor's transform) was marked dirty
+        // Only the entities recorded by "Entity::invalidateWorldMatrix" are visited, so the cost depends on the number of
+        // changed entities, not on the size of the world. Each entity resolves its parent first, so every matrix is computed once.
+        // Call this once per frame after the logic systems so that the renderer only reads cached matrices.
+        // The local matrices of the dirty entities are composed first in parallel using the batched kernels of "transform-batch.hpp".
+        void updateTransforms();
+
+        // Starts a fixed simulation step. The pending transform changes are resolved first, then the world matrix of each entity
+        // is recorded as its previous matrix the first time it changes during the step.
+        void beginSimulationStep();
+        // Blends the world matrices of the entities that moved during the last simulation step between the start & the end of the step
+        // "alpha" is the fraction of the next step that already elapsed (0 gives the previous matrices, 1 the current ones).
+        // The results are read using "Entity::getRenderMatrix". The other entities (and the ones created during the step) use their current matrix.
+        void interpolateTransforms(float alpha);
+
+        // Returns the command buffer of the calling thread. Systems running on any thread can record structural changes in it.
+        // The recorded commands are applied when "playbackCommands" is called.
+        CommandBuffer& getCommandBuffer();
+        // Applies the commands recorded in all the command buffers then clears the buffers
+        // This must be called from a single thread while no system is running (e.g. after the systems of the frame are done).
+        // First, the entities are created in recording order. Then, the other commands are sorted by entity so that the changes
+        // to each entity are applied together, in the order they were recorded (e.g. removing then adding a component leaves the
+        // component on the entity). Destroyed entities are only deleted after all the commands are applied.
+        // Commands targeting deleted entities (or entities destroyed earlier in the playback) are ignored.
+        void playbackCommands();
+
+        // Updates the match lists of the queries (in the PER_ENTITY storage mode) and records the entity in the change feeds
+        // that it started or stopped matching after its signature changed from "oldSignature"
+        // This is called by the entity itself whenever it gains or loses a component.
+        void onSignatureChanged(Entity* entity, ComponentSignature oldSignature);
 
         // This will deserialize a json array of entities and add the new entities to the current world
         // If parent pointer is not null, the new entities will be have their parent set to that given pointer
@@ -27,18 +201,44 @@ namespace our {
             //TODO: (Req 8) Create a new entity, set its world member variable to this,
             // and don't forget to insert it in the suitable container.
             
-            // Create a new entity
-            Entity* entity = new Entity();
+            // Create a new entity in a slot from the entity pool
+            Entity* entity = new (entityPool.allocate()) Entity();
             // set its world member variable to this
             entity->world = this;
+            // give it an ID (reusing the ID of a deleted entity if possible)
+            if(!freeIDs.empty()){
+                entity->id = freeIDs.back();
+                freeIDs.pop_back();
+            } else {
+                entity->id = (uint32_t)slots.size();
+                slots.emplace_back();
+            }
+            slots[entity->id].entity = entity;
+            entity->generation = slots[entity->id].generation;
             // insert it in the container of entities
-            entities.insert(entity);
+            entity->index = (uint32_t)entities.size();
+            entities.push_back(entity);
+            // its world matrix is computed by the next transform pass
+            entity->invalidateWorldMatrix();
             // return it
             return entity;
         }
 
-        // This returns and immutable reference to the set of all entites in the world.
-        const std::unordered_set<Entity*>& getEntities() {
+        // Returns the entity referred to by the handle or null if that entity was deleted (O(1))
+        Entity* get(EntityHandle handle) const {
+            if(handle.index >= slots.size() || slots[handle.index].generation != handle.generation) return nullptr;
+            return slots[handle.index].entity;
+        }
+        // Returns true if the entity referred to by the handle exists and is not marked for removal (O(1))
+        bool isAlive(EntityHandle handle) const {
+            Entity* entity = get(handle);
+            return entity && !entity->isMarkedForRemoval();
+        }
+
+        // This returns and immutable reference to the array of all entites in the world.
+        // The entities are stored densely in creation order, except that deleting an entity moves the last entity into its place.
+        // So iterating over them is linear in memory and gives the same order on every run.
+        const std::vector<Entity*>& getEntities() {
             return entities;
         }
 
@@ -47,10 +247,14 @@ namespace our {
         void markForRemoval(Entity* entity){
             //TODO: (Req 8) If the entity is in this world, add it to the "markedForRemoval" set.
             
-            // check if the entity found in entities.
-            if(entities.find(entity) != entities.end())
+            // check if the entity belongs to this world and is not already marked.
+            if(entity && entity->world == this && !entity->removalPending){
                 // insert it to markedForRemoval
-                markedForRemoval.insert(entity);
+                entity->removalPending = true;
+                markedForRemoval.push_back(entity);
+                // the systems watching it can forget it now
+                recordChange(entity, entity->signature);
+            }
         }
 
         // This removes the elements in "markedForRemoval" from the "entities" set.
@@ -61,8 +265,7 @@ namespace our {
             // for loop to all entities in markedForRemoval
             for(auto entity: markedForRemoval){
                 // erase it from entities and delete it 
-                entities.erase(entity);
-                delete entity;
+                destroy(entity);
             }
             // clear all markedForRemoval entities.
             markedForRemoval.clear();
@@ -74,19 +277,39 @@ namespace our {
             
             // for loop to all entities, and then 
             // then clear all entites and markedForRemoval entities.
-            for(auto entity: entities){
+            // We destroy them from the back so that no entity has to be moved to fill a hole
+            while(!entities.empty()){
                 // delete the entity
-                delete entity;
+                destroy(entities.back());
             }
-            // clear all entites
-            entities.clear();
             // clear all markedForRemoval entities.
             markedForRemoval.clear();
+            // drop the commands that were not played back and the transform changes that were not processed
+            for(auto& data : threads){
+                data->commands.reset();
+                data->commands.created.clear();
+                data->dirtyTransforms.clear();
+            }
+            changedTransforms.clear();
+            steppedEntities.clear();
+            for(auto& feed : feeds) feed->changes.clear();
+            // Finally, we free the archetypes and the queries since they no longer hold any entity
+            // The pools are kept so that their pages are reused if the world is populated again
+            for(auto archetype : archetypeList){
+                releasedStats += archetype->getStats();
+                delete archetype;
+            }
+            archetypeList.clear();
+            archetypes.clear();
+            for(auto query : queryList) delete query;
+            queryList.clear();
+            queries.clear();
         }
 
         //Since the world owns all of its entities, they should be deleted alongside it.
         ~World(){
             clear();
+            for(auto pool : componentPools) delete pool;
         }
 
         // The world should not be copyable
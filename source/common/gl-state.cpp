@@ -0,0 +1,176 @@
+#include "gl-state.hpp"
+
+#include <iostream>
+
+namespace our {
+
+    GLState& GLState::get() {
+        static GLState state;
+        return state;
+    }
+
+    void GLState::setEnabled(GLenum capability, bool enable) {
+        for(int index = 0; index < CAPABILITY_COUNT; index++) {
+            if(CAPABILITIES[index] != capability) continue;
+            if(!change(enabled[index], (int8_t)enable)) return;
+            break;
+        }
+        if(enable) glEnable(capability); else glDisable(capability);
+    }
+
+    void GLState::cullFace(GLenum face) {
+        if(change(culledFace, face)) glCullFace(face);
+    }
+
+    void GLState::frontFace(GLenum winding) {
+        if(change(frontFaceWinding, winding)) glFrontFace(winding);
+    }
+
+    void GLState::depthFunc(GLenum function) {
+        if(change(depthFunction, function)) glDepthFunc(function);
+    }
+
+    void GLState::blendEquation(GLenum mode) {
+        if(change(blendEquationMode, mode)) glBlendEquation(mode);
+    }
+
+    void GLState::blendFunc(GLenum source, GLenum destination) {
+        // Both factors are set by one call, so they are compared together
+        if(blendSource == source && blendDestination == destination) { stats.elided++; return; }
+        blendSource = source;
+        blendDestination = destination;
+        stats.issued++;
+        glBlendFunc(source, destination);
+    }
+
+    void GLState::blendColor(const glm::vec4& color) {
+        if(blendConstantKnown && blendConstant == color) { stats.elided++; return; }
+        blendConstant = color;
+        blendConstantKnown = true;
+        stats.issued++;
+        glBlendColor(color.r, color.g, color.b, color.a);
+    }
+
+    void GLState::colorMask(glm::bvec4 mask) {
+        bool same = true;
+        for(int channel = 0; channel < 4; channel++) same = same && colorWriteMask[channel] == (int8_t)mask[channel];
+        if(same) { stats.elided++; return; }
+        for(int channel = 0; channel < 4; channel++) colorWriteMask[channel] = (int8_t)mask[channel];
+        stats.issued++;
+        glColorMask(mask.r, mask.g, mask.b, mask.a);
+    }
+
+    void GLState::depthMask(bool mask) {
+        if(change(depthWriteMask, (int8_t)mask)) glDepthMask(mask);
+    }
+
+    void GLState::useProgram(GLuint name) {
+        if(change(program, name)) glUseProgram(name);
+    }
+
+    void GLState::activeTexture(GLenum unit) {
+        if(change(activeUnit, (GLuint)(unit - GL_TEXTURE0))) glActiveTexture(unit);
+    }
+
+    void GLState::bindTexture2D(GLuint name) {
+        // If the active unit is unknown (or not tracked), we can't know which binding changes
+        if(activeUnit >= MAX_TEXTURE_UNITS) {
+            stats.issued++;
+            glBindTexture(GL_TEXTURE_2D, name);
+            return;
+        }
+        if(change(textures[activeUnit], name)) glBindTexture(GL_TEXTURE_2D, name);
+    }
+
+    void GLState::bindSampler(GLuint unit, GLuint name) {
+        if(unit >= MAX_TEXTURE_UNITS) {
+            stats.issued++;
+            glBindSampler(unit, name);
+            return;
+        }
+        if(change(samplers[unit], name)) glBindSampler(unit, name);
+    }
+
+    // Deleting a program that is in use doesn't unbind it (it is deleted when it stops being used)
+    // but the name can be reused right away, so the shadow copy must not match the new program.
+    void GLState::forgetProgram(GLuint name) {
+        if(program == name) program = UNKNOWN;
+    }
+
+    void GLState::forgetTexture(GLuint name) {
+        for(GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            if(textures[unit] == name) textures[unit] = 0;
+    }
+
+    void GLState::forgetSampler(GLuint name) {
+        for(GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++)
+            if(samplers[unit] == name) samplers[unit] = 0;
+    }
+
+    void GLState::invalidate() {
+        for(int index = 0; index < CAPABILITY_COUNT; index++) enabled[index] = UNKNOWN_FLAG;
+        culledFace = frontFaceWinding = depthFunction = UNKNOWN;
+        blendEquationMode = blendSource = blendDestination = UNKNOWN;
+        blendConstantKnown = false;
+        for(int channel = 0; channel < 4; channel++) colorWriteMask[channel] = UNKNOWN_FLAG;
+        depthWriteMask = UNKNOWN_FLAG;
+        program = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for(GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++) textures[unit] = samplers[unit] = UNKNOWN;
+    }
+
+    int GLState::validate() {
+        int mismatches = 0;
+        // Only the known values are compared since the unknown ones will be set by the next call anyway
+        auto check = [&mismatches](const char* name, GLint cached, GLint actual){
+            if(cached == (GLint)UNKNOWN || cached == actual) return;
+            std::cerr << "GL state cache mismatch: " << name << " is " << actual << " but the cache has " << cached << std::endl;
+            mismatches++;
+        };
+        auto getInteger = [](GLenum parameter){ GLint value = 0; glGetIntegerv(parameter, &value); return value; };
+
+        const char* capabilityNames[CAPABILITY_COUNT] = { "GL_CULL_FACE", "GL_DEPTH_TEST", "GL_BLEND" };
+        for(int index = 0; index < CAPABILITY_COUNT; index++)
+            if(enabled[index] != UNKNOWN_FLAG) check(capabilityNames[index], enabled[index], glIsEnabled(CAPABILITIES[index]) ? 1 : 0);
+        check("GL_CULL_FACE_MODE", (GLint)culledFace, getInteger(GL_CULL_FACE_MODE));
+        check("GL_FRONT_FACE", (GLint)frontFaceWinding, getInteger(GL_FRONT_FACE));
+        check("GL_DEPTH_FUNC", (GLint)depthFunction, getInteger(GL_DEPTH_FUNC));
+        check("GL_BLEND_EQUATION_RGB", (GLint)blendEquationMode, getInteger(GL_BLEND_EQUATION_RGB));
+        check("GL_BLEND_SRC_RGB", (GLint)blendSource, getInteger(GL_BLEND_SRC_RGB));
+        check("GL_BLEND_DST_RGB", (GLint)blendDestination, getInteger(GL_BLEND_DST_RGB));
+        if(blendConstantKnown) {
+            glm::vec4 actual;
+            glGetFloatv(GL_BLEND_COLOR, &actual.r);
+            // The driver clamps the color to [0, 1] before storing it
+            check("GL_BLEND_COLOR", 1, glm::all(glm::equal(actual, glm::clamp(blendConstant, 0.0f, 1.0f))) ? 1 : 0);
+        }
+        GLboolean colorMaskActual[4];
+        glGetBooleanv(GL_COLOR_WRITEMASK, colorMaskActual);
+        for(int channel = 0; channel < 4; channel++)
+            if(colorWriteMask[channel] != UNKNOWN_FLAG) check("GL_COLOR_WRITEMASK", colorWriteMask[channel], colorMaskActual[channel] ? 1 : 0);
+        GLboolean depthMaskActual;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthMaskActual);
+        if(depthWriteMask != UNKNOWN_FLAG) check("GL_DEPTH_WRITEMASK", depthWriteMask, depthMaskActual ? 1 : 0);
+        check("GL_CURRENT_PROGRAM", (GLint)program, getInteger(GL_CURRENT_PROGRAM));
+
+        // The texture & sampler bindings are read per unit, so we visit each unit then restore the active one
+        GLint actualUnit = getInteger(GL_ACTIVE_TEXTURE);
+        check("GL_ACTIVE_TEXTURE", activeUnit == UNKNOWN ? (GLint)UNKNOWN : (GLint)(GL_TEXTURE0 + activeUnit), actualUnit);
+        for(GLuint unit = 0; unit < MAX_TEXTURE_UNITS; unit++) {
+            if(textures[unit] == UNKNOWN && samplers[unit] == UNKNOWN) continue;
+            glActiveTexture(GL_TEXTURE0 + unit);
+            check("GL_TEXTURE_BINDING_2D", (GLint)textures[unit], getInteger(GL_TEXTURE_BINDING_2D));
+            check("GL_SAMPLER_BINDING", (GLint)samplers[unit], getInteger(GL_SAMPLER_BINDING));
+        }
+        glActiveTexture(actualUnit);
+
+        if(mismatches > 0) invalidate();
+        return mismatches;
+    }
+
+    void GLState::endFrame() {
+        frameStats = stats;
+        stats = GLStateStats();
+    }
+
+}
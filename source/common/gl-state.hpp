@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace our {
+
+    // The number of OpenGL calls that went through the state cache
+    struct GLStateStats {
+        uint64_t issued = 0; // The calls that reached the driver because the value changed (or was unknown)
+        uint64_t elided = 0; // The calls that were dropped because the value was already set
+    };
+
+    // A shadow copy of the OpenGL state set by the pipeline states, the materials, the textures, the samplers & the shaders.
+    // Each function below has the same effect as the OpenGL function with the same name, but it only calls the driver
+    // if the value differs from the last value set through the cache. Everything that changes this state should go through
+    // the cache, otherwise the shadow copy would be wrong and a needed call could be skipped.
+    // Code that changes the state behind the cache's back (and doesn't restore it) should call "invalidate" afterwards.
+    // NOTE: ImGui changes some of this state while drawing but restores it before returning, so it doesn't need to invalidate.
+    class GLState {
+    public:
+        static constexpr GLuint MAX_TEXTURE_UNITS = 16; // The texture units tracked by the cache (the others are not cached)
+
+    private:
+        static constexpr GLenum UNKNOWN = 0xFFFFFFFFu; // A value that no OpenGL enum or object name can take
+        static constexpr int8_t UNKNOWN_FLAG = -1;
+
+        // The capabilities tracked by "setEnabled" and their states (UNKNOWN_FLAG, 0 or 1)
+        static constexpr GLenum CAPABILITIES[] = { GL_CULL_FACE, GL_DEPTH_TEST, GL_BLEND };
+        static constexpr int CAPABILITY_COUNT = sizeof(CAPABILITIES) / sizeof(CAPABILITIES[0]);
+        int8_t enabled[CAPABILITY_COUNT];
+
+        GLenum culledFace, frontFaceWinding, depthFunction;
+        GLenum blendEquationMode, blendSource, blendDestination;
+        glm::vec4 blendConstant;
+        bool blendConstantKnown;
+        int8_t colorWriteMask[4], depthWriteMask;
+        GLuint program;
+        GLuint activeUnit; // The index of the active texture unit (not the GL_TEXTUREi enum)
+        GLuint textures[MAX_TEXTURE_UNITS], samplers[MAX_TEXTURE_UNITS];
+
+        GLStateStats stats, frameStats;
+
+        GLState() { invalidate(); }
+
+        // Stores the value and returns true if it changed. Either way, the call is counted.
+        template<typename T>
+        bool change(T& cached, const T& value) {
+            if(cached == value) { stats.elided++; return false; }
+            cached = value;
+            stats.issued++;
+            return true;
+        }
+
+    public:
+        // Returns the state cache of the OpenGL context (the application only creates one context)
+        static GLState& get();
+
+        // Works like glEnable/glDisable. The capabilities other than face culling, depth testing & blending are not cached.
+        void setEnabled(GLenum capability, bool enable);
+        void cullFace(GLenum face);
+        void frontFace(GLenum winding);
+        void depthFunc(GLenum function);
+        void blendEquation(GLenum mode);
+        void blendFunc(GLenum source, GLenum destination);
+        void blendColor(const glm::vec4& color);
+        void colorMask(glm::bvec4 mask);
+        void depthMask(bool mask);
+        void useProgram(GLuint name);
+        // Takes the unit enum like glActiveTexture (e.g. GL_TEXTURE1)
+        void activeTexture(GLenum unit);
+        // Binds a 2D texture to the active texture unit
+        void bindTexture2D(GLuint name);
+        void bindSampler(GLuint unit, GLuint name);
+
+        // OpenGL unbinds an object when it is deleted, so these are called before deleting one to update the shadow copy
+        // (otherwise a new object reusing the name would never be bound)
+        void forgetProgram(GLuint name);
+        void forgetTexture(GLuint name);
+        void forgetSampler(GLuint name);
+
+        // Forgets the whole shadow copy, so the next call of each kind reaches the driver
+        void invalidate();
+
+        // Compares the shadow copy with the real state (read with glGet) and prints every difference.
+        // The cache is invalidated if there is a difference. Returns the number of differences.
+        // This is slow since every glGet waits for the driver, so the application only calls it once per frame in debug builds.
+        int validate();
+
+        // Stores the counters of the current frame (see "getFrameStats") and restarts them
+        void endFrame();
+        // Returns the counters of the last completed frame
+        const GLStateStats& getFrameStats() const { return frameStats; }
+    };
+
+}
@@ -0,0 +1,43 @@
+#include "task-graph.hpp"
+
+namespace our {
+
+    size_t TaskGraph::add(Task task, bool mainThread) {
+        auto node = std::make_unique<Node>();
+        node->task = std::move(task);
+        node->mainThread = mainThread;
+        nodes.push_back(std::move(node));
+        return nodes.size() - 1;
+    }
+
+    void TaskGraph::precede(size_t before, size_t after) {
+        nodes[before]->successors.push_back(after);
+        nodes[after]->dependencyCount++;
+    }
+
+    // Submits the node to the pool. When it finishes, it releases the successors whose dependencies are all finished.
+    void TaskGraph::schedule(ThreadPool& pool, TaskGroup& group, size_t index) {
+        Node* node = nodes[index].get();
+        Task task = [this, &pool, &group, node](){
+            node->task();
+            for(size_t successor : node->successors)
+                if(nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                    schedule(pool, group, successor);
+        };
+        if(node->mainThread) pool.submitToMainThread(std::move(task), &group);
+        else pool.submit(std::move(task), &group);
+    }
+
+    void TaskGraph::run(ThreadPool& pool) {
+        TaskGroup group;
+        for(auto& node : nodes)
+            node->remaining.store(node->dependencyCount, std::memory_order_relaxed);
+        for(size_t index = 0; index < nodes.size(); index++)
+            if(nodes[index]->dependencyCount == 0)
+                schedule(pool, group, index);
+        // The successors are submitted (and counted in the group) before their predecessor's task is counted as done,
+        // so the group can only become empty once every node has finished
+        pool.wait(group);
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "thread-pool.hpp"
+#include <vector>
+#include <atomic>
+#include <memory>
+
+namespace our {
+
+    // A task graph is a set of tasks with dependencies between them.
+    // When the graph runs, a task is submitted to the thread pool as soon as all the tasks it depends on are finished,
+    // so the tasks that don't depend on each other run at the same time.
+    // The graph can be run many times (e.g. once per frame) without being rebuilt.
+    class TaskGraph {
+        struct Node {
+            Task task;
+            bool mainThread;                  // If true, the task must run on the thread that calls "run"
+            std::vector<size_t> successors;   // The nodes that depend on this node
+            size_t dependencyCount = 0;       // The number of nodes this node depends on
+            std::atomic<size_t> remaining{0}; // The number of dependencies that are not finished yet in the current run
+        };
+        std::vector<std::unique_ptr<Node>> nodes;
+
+        void schedule(ThreadPool& pool, TaskGroup& group, size_t index);
+
+    public:
+        // Adds a task to the graph and returns its index
+        // If "mainThread" is true, the task will only be executed by the thread calling "run" (e.g. for OpenGL or input calls)
+        size_t add(Task task, bool mainThread = false);
+        // Makes the task "after" wait for the task "before" to finish
+        void precede(size_t before, size_t after);
+        // Runs all the tasks respecting their dependencies and returns when all of them are finished
+        void run(ThreadPool& pool = ThreadPool::get());
+
+        size_t size() const { return nodes.size(); }
+        void clear() { nodes.clear(); }
+    };
+
+}
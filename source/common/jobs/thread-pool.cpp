@@ -0,0 +1,116 @@
+#include "thread-pool.hpp"
+
+namespace our {
+
+    thread_local size_t ThreadPool::currentQueue = 0;
+
+    ThreadPool::ThreadPool(size_t workerCount) {
+        queues.emplace_back(new Queue());
+        for(size_t index = 0; index < workerCount; index++)
+            queues.emplace_back(new Queue());
+        for(size_t index = 0; index < workerCount; index++)
+            workers.emplace_back(&ThreadPool::workerLoop, this, index + 1);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        wakeUp.notify_all();
+        for(auto& worker : workers) worker.join();
+    }
+
+    ThreadPool& ThreadPool::get() {
+        unsigned int cores = std::thread::hardware_concurrency();
+        static ThreadPool pool(cores > 1 ? cores - 1 : 0);
+        return pool;
+    }
+
+    void ThreadPool::push(Queue& queue, Task task, TaskGroup* group) {
+        if(group) group->pending.fetch_add(1, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task), group);
+    }
+
+    bool ThreadPool::pop(Queue& queue, std::pair<Task, TaskGroup*>& task, bool back) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) return false;
+        if(back) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+        return true;
+    }
+
+    void ThreadPool::execute(std::pair<Task, TaskGroup*>& task) {
+        task.first();
+        // The thread waiting for the group (if any) is woken up by its last task
+        // (the group itself isn't touched after that since the waiting thread could destroy it right away)
+        if(task.second && task.second->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            { std::lock_guard<std::mutex> lock(sleepMutex); }
+            waiting.notify_all();
+        }
+    }
+
+    void ThreadPool::submit(Task task, TaskGroup* group) {
+        // Workers push to their own queue while other threads push to the shared queue
+        queued.fetch_add(1, std::memory_order_release);
+        push(*queues[currentQueue], std::move(task), group);
+        // Locking before notifying ensures a worker that just found no work doesn't miss this wake up
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        wakeUp.notify_one();
+        waiting.notify_all();
+    }
+
+    void ThreadPool::submitToMainThread(Task task, TaskGroup* group) {
+        mainQueued.fetch_add(1, std::memory_order_release);
+        push(mainQueue, std::move(task), group);
+        { std::lock_guard<std::mutex> lock(sleepMutex); }
+        waiting.notify_all();
+    }
+
+    bool ThreadPool::runPending() {
+        std::pair<Task, TaskGroup*> task;
+        // Non-worker threads are the only ones allowed to run the main thread tasks
+        if(currentQueue == 0 && pop(mainQueue, task, false)) {
+            mainQueued.fetch_sub(1, std::memory_order_relaxed);
+            execute(task);
+            return true;
+        }
+        // First, we look in our own queue (newest first), then we steal the oldest task from the other queues
+        bool found = pop(*queues[currentQueue], task, currentQueue != 0);
+        for(size_t offset = 1; !found && offset < queues.size(); offset++)
+            found = pop(*queues[(currentQueue + offset) % queues.size()], task, false);
+        if(!found) return false;
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        execute(task);
+        return true;
+    }
+
+    void ThreadPool::wait(TaskGroup& group) {
+        while(!group.isDone()) {
+            if(runPending()) continue;
+            // Nothing can be executed here, so we sleep until the group is finished or a task that we can run is submitted
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            waiting.wait(lock, [this, &group](){
+                return group.isDone() || queued.load(std::memory_order_acquire) > 0 ||
+                       (currentQueue == 0 && mainQueued.load(std::memory_order_acquire) > 0);
+            });
+        }
+    }
+
+    void ThreadPool::workerLoop(size_t index) {
+        currentQueue = index;
+        while(true) {
+            if(runPending()) continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this](){ return !running || queued.load(std::memory_order_acquire) > 0; });
+            if(!running) return;
+        }
+    }
+
+}
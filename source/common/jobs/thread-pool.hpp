@@ -0,0 +1,112 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace our {
+
+    typedef std::function<void()> Task;
+
+    // A task group counts the tasks that were submitted through it and are not finished yet.
+    // It is used to wait for a batch of tasks (see "ThreadPool::wait").
+    class TaskGroup {
+        std::atomic<int> pending{0};
+        friend class ThreadPool;
+    public:
+        bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+    };
+
+    // A work-stealing thread pool.
+    // Every worker owns a queue: it pushes & pops its own tasks at the back (so recently spawned tasks run while their data is hot)
+    // and when its queue is empty, it steals from the front of the other queues.
+    // Threads that are not workers (e.g. the main thread) push to a shared queue and help executing tasks while they wait.
+    // Tasks marked as "main thread only" are kept in a separate queue that only non-worker threads execute (e.g. OpenGL or windowing calls).
+    class ThreadPool {
+        struct Queue {
+            std::deque<std::pair<Task, TaskGroup*>> tasks;
+            std::mutex mutex;
+        };
+
+        std::vector<std::unique_ptr<Queue>> queues; // queues[0] is the shared queue, queues[i+1] belongs to worker i
+        Queue mainQueue;                            // The tasks that must run on a non-worker thread
+        std::vector<std::thread> workers;
+        std::atomic<bool> running{true};
+        std::atomic<int> queued{0};                 // The number of tasks waiting in the worker & shared queues
+        std::atomic<int> mainQueued{0};             // The number of tasks waiting in "mainQueue"
+        std::mutex sleepMutex;
+        std::condition_variable wakeUp;             // Wakes the sleeping workers when a task is submitted
+        // Wakes the threads sleeping in "wait" when a group is finished or when a task they could run is submitted
+        std::condition_variable waiting;
+
+        // The index of the queue owned by the current thread (0 for non-worker threads)
+        static thread_local size_t currentQueue;
+
+        void push(Queue& queue, Task task, TaskGroup* group);
+        bool pop(Queue& queue, std::pair<Task, TaskGroup*>& task, bool back);
+        void execute(std::pair<Task, TaskGroup*>& task);
+        void workerLoop(size_t index);
+
+    public:
+        // Creates a pool with the given number of worker threads
+        // The calling thread also executes tasks while it waits, so "hardware_concurrency - 1" workers use all the cores.
+        explicit ThreadPool(size_t workerCount);
+        ~ThreadPool();
+
+        // Returns a pool shared by the whole application with one worker per core (minus the main thread)
+        static ThreadPool& get();
+
+        // Returns the number of threads that can execute tasks at the same time (the workers + the waiting thread)
+        size_t getThreadCount() const { return workers.size() + 1; }
+
+        // Submits a task. If a group is given, the task is counted in the group until it finishes.
+        void submit(Task task, TaskGroup* group = nullptr);
+        // Submits a task that will only be executed by a non-worker thread (inside "wait" or "runPending")
+        void submitToMainThread(Task task, TaskGroup* group = nullptr);
+        // Executes one pending task if any. Returns false if there was nothing to execute.
+        bool runPending();
+        // Executes tasks until every task of the group is finished
+        // If there is nothing to execute while the last tasks of the group run on other threads, the caller sleeps.
+        void wait(TaskGroup& group);
+
+        // Calls "function(begin, end)" over sub-ranges of [begin, end) in parallel and returns when all of them are done
+        // The range is split into pieces of at least "grainSize" items (and not more pieces than are useful for the threads)
+        template<typename F>
+        void parallelFor(size_t begin, size_t end, size_t grainSize, F&& function) {
+            if(begin >= end) return;
+            size_t count = end - begin;
+            grainSize = std::max<size_t>(grainSize, 1);
+            // A few pieces per thread give the stealing some room to balance uneven work
+            size_t pieces = std::min((count + grainSize - 1) / grainSize, getThreadCount() * 4);
+            if(pieces <= 1) {
+                function(begin, end);
+                return;
+            }
+            TaskGroup group;
+            size_t pieceSize = (count + pieces - 1) / pieces;
+            for(size_t pieceBegin = begin + pieceSize; pieceBegin < end; pieceBegin += pieceSize) {
+                size_t pieceEnd = std::min(pieceBegin + pieceSize, end);
+                submit([&function, pieceBegin, pieceEnd](){ function(pieceBegin, pieceEnd); }, &group);
+            }
+            // The calling thread processes the first piece itself then helps with the rest
+            function(begin, std::min(begin + pieceSize, end));
+            wait(group);
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+    };
+
+    // A shortcut to "ThreadPool::get().parallelFor(...)"
+    template<typename F>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, F&& function) {
+        ThreadPool::get().parallelFor(begin, end, grainSize, std::forward<F>(function));
+    }
+
+}
@@ -5,11 +5,24 @@
 
 namespace our {
 
+    // The names of the material uniforms (hashed at compile time)
+    namespace uniforms {
+        constexpr UniformName TINT("tint"), ALPHA_THRESHOLD("alphaThreshold"), TEX("tex");
+        constexpr UniformName ALBEDO("material.albedo"), SPECULAR("material.specular"), AMBIENT_OCCLUSION("material.ambient_occlusion");
+        constexpr UniformName ROUGHNESS("material.roughness"), EMISSIVE("material.emissive");
+    }
+
+    Material::Material() {
+        static uint32_t count = 0;
+        id = count++;
+    }
+
     // This function should setup the pipeline state and set the shader to be used
     void Material::setup() const {
         //TODO: (Req 6) Write this function
         pipelineState.setup();
         shader->use();
+        setupParameters(shader);
     }
 
     // This function read the material data from a json object
@@ -23,12 +36,10 @@ namespace our {
         transparent = data.value("transparent", false);
     }
 
-    // This function should call the setup of its parent and
-    // set the "tint" uniform to the value in the member variable tint 
-    void TintedMaterial::setup() const {
+    // This function should set the "tint" uniform to the value in the member variable tint 
+    void TintedMaterial::setupParameters(ShaderProgram* program) const {
         //TODO: (Req 6) Write this function
-        Material::setup();
-        shader->set("tint",tint);
+        program->set(uniforms::TINT,tint);
     }
 
     // This function read the material data from a json object
@@ -38,19 +49,19 @@ namespace our {
         tint = data.value("tint", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
     }
 
-    // This function should call the setup of its parent and
+    // This function should call the setupParameters of its parent and
     // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
     // Then it should bind the texture and sampler to a texture unit and send the unit number to the uniform variable "tex" 
-    void TexturedMaterial::setup() const {
+    void TexturedMaterial::setupParameters(ShaderProgram* program) const {
         //TODO: (Req 6) Write this function
-        TintedMaterial::setup();
-        shader->set("alphaThreshold",alphaThreshold);
+        TintedMaterial::setupParameters(program);
+        program->set(uniforms::ALPHA_THRESHOLD,alphaThreshold);
         if(texture != NULL && sampler !=NULL)
         {
-        glActiveTexture(GL_TEXTURE0); //we send it unit 0 
+        GLState::get().activeTexture(GL_TEXTURE0); //we send it unit 0 
         texture->bind();
         sampler->bind(0);
-        shader->set("tex",0);
+        program->set(uniforms::TEX,0);
         }
     }
 
@@ -65,70 +76,70 @@ namespace our {
     }
 
     // ------------------- light material ------------------- //
-     void LitMaterial::setup() const {
-        // call setup function for textured material
-        TexturedMaterial::setup(); 
+     void LitMaterial::setupParameters(ShaderProgram* program) const {
+        // call setupParameters function for textured material
+        TexturedMaterial::setupParameters(program);
 
         // if it's albedo
         if (albedo){
             // Here we set the active texture unit to 0 
-            glActiveTexture(GL_TEXTURE0);
+            GLState::get().activeTexture(GL_TEXTURE0);
             // then bind the texture to it
             albedo->bind();
             // binds this sampler to texture unit 0
             sampler->bind(0);
             // send the unit number 0 to 'albedo' in the uniform variable material
-            shader->set("material.albedo",0);
+            program->set(uniforms::ALBEDO,0);
         }
 
         // if it's specular
         if (specular){
             // Here we set the active texture unit to 1
-            glActiveTexture(GL_TEXTURE1);  
+            GLState::get().activeTexture(GL_TEXTURE1);  
             // then bind the texture to it
             specular->bind();
             // binds this sampler to texture unit 1
             sampler->bind(1);
             // send the unit number 1 to 'specular' in the uniform variable material
-            shader->set("material.specular",1);
+            program->set(uniforms::SPECULAR,1);
         }
         
         // if it's ambient_occlusion
         if (ambient_occlusion){
             // Here we set the active texture unit to 2
-            glActiveTexture(GL_TEXTURE2);  
+            GLState::get().activeTexture(GL_TEXTURE2);  
             // then bind the texture to it
             ambient_occlusion->bind();
             // binds this sampler to texture unit 2
             sampler->bind(2);
             // send the unit number 2 to 'ambient_occlusion' in the uniform variable material
-            shader->set("material.ambient_occlusion",2);
+            program->set(uniforms::AMBIENT_OCCLUSION,2);
         }
         
         // if it's roughness
         if (roughness){
             // Here we set the active texture unit to 3
-            glActiveTexture(GL_TEXTURE3);  
+            GLState::get().activeTexture(GL_TEXTURE3);  
             // then bind the texture to it
             roughness->bind();
             // binds this sampler to texture unit 3
             sampler->bind(3);
             // send the unit number 3 to 'roughness' in the uniform variable material
-            shader->set("material.roughness",3);
+            program->set(uniforms::ROUGHNESS,3);
         }
   
         // if it's emissive
         if (emissive){
             // Here we set the active texture unit to 4
-            glActiveTexture(GL_TEXTURE4); 
+            GLState::get().activeTexture(GL_TEXTURE4); 
             // then bind the texture to it 
             emissive->bind();
             // binds this sampler to texture unit 4
             sampler->bind(4);
             // send the unit number 4 to 'emissive' in the uniform variable material
-            shader->set("material.emissive",4);
+            program->set(uniforms::EMISSIVE,4);
         }
-        glActiveTexture(GL_TEXTURE0);
+        GLState::get().activeTexture(GL_TEXTURE0);
     }
 
     // This function read the material data from a json object
@@ -10,6 +10,14 @@
 
 namespace our {
 
+    // The kinds of materials (used by the renderer to pick the uniforms to send without testing the material type for every draw)
+    enum class MaterialKind {
+        BASIC,
+        TINTED,
+        TEXTURED,
+        LIT
+    };
+
     // This is the base class for all the materials
     // It contains the 3 essential components required by any material
     // 1- The pipeline state when drawing objects using this material
@@ -17,15 +25,26 @@ namespace our {
     // 3- Whether this material is transparent or not
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
     class Material {
+        uint32_t id;
     public:
         PipelineState pipelineState;
         ShaderProgram* shader;
         bool transparent;
-        
-        // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+
+        Material();
+
+        // This function does 3 things: setup the pipeline state, set the shader program to be used and send the material parameters
+        void setup() const;
+        // This function sends the uniforms & binds the textures of the material to the given program, which must already be in use.
+        // The renderer calls it alone when the previous draw already applied the same shader & pipeline state,
+        // and passes the instanced variant of the shader for the instanced draws.
+        virtual void setupParameters(ShaderProgram*) const {}
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
+
+        virtual MaterialKind getKind() const { return MaterialKind::BASIC; }
+        // Returns a number that identifies this material (given in the order of creation)
+        uint32_t getId() const { return id; }
     };
 
     // This material adds a uniform for a tint (a color that will be sent to the shader)
@@ -34,8 +53,9 @@ namespace our {
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setupParameters(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json& data) override;
+        MaterialKind getKind() const override { return MaterialKind::TINTED; }
     };
 
     // This material adds two uniforms (besides the tint from Tinted Material)
@@ -49,8 +69,9 @@ namespace our {
         Sampler* sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setupParameters(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json& data) override;
+        MaterialKind getKind() const override { return MaterialKind::TEXTURED; }
     };
 
     // lighting material class
@@ -70,8 +91,9 @@ namespace our {
         Texture2D* emissive;
         Sampler* sampler;
 
-        void setup() const override;            
+        void setupParameters(ShaderProgram* program) const override;
         void deserialize(const nlohmann::json& data) override;
+        MaterialKind getKind() const override { return MaterialKind::LIT; }
     };
 
     // This function returns a new material instance based on the given type
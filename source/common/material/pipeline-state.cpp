@@ -63,4 +63,19 @@ namespace our {
         depthMask = data.value("depthMask", depthMask);
     }
 
+    bool PipelineState::operator==(const PipelineState& other) const {
+        return faceCulling.enabled == other.faceCulling.enabled
+            && faceCulling.culledFace == other.faceCulling.culledFace
+            && faceCulling.frontFace == other.faceCulling.frontFace
+            && depthTesting.enabled == other.depthTesting.enabled
+            && depthTesting.function == other.depthTesting.function
+            && blending.enabled == other.blending.enabled
+            && blending.equation == other.blending.equation
+            && blending.sourceFactor == other.blending.sourceFactor
+            && blending.destinationFactor == other.blending.destinationFactor
+            && blending.constantColor == other.blending.constantColor
+            && colorMask == other.colorMask
+            && depthMask == other.depthMask;
+    }
+
 }
\ No newline at end of file
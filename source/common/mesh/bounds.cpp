@@ -0,0 +1,63 @@
+#include "bounds.hpp"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#   define OUR_BOUNDS_SSE
+#   include <xmmintrin.h>
+#endif
+
+namespace our {
+
+    // Computes the min & max of the positions. Each position is loaded as one 4-wide vector.
+    // The 4th lane reads the color that follows the position in the vertex and is ignored.
+    static BoundingBox computeBox(const Vertex* vertices, size_t count) {
+        BoundingBox box;
+        if(count == 0) return box;
+#if defined(OUR_BOUNDS_SSE)
+        static_assert(offsetof(Vertex, color) == sizeof(glm::vec3) && sizeof(Color) == sizeof(float),
+            "The SIMD pass reads 4 floats from the position of each vertex");
+        // Two pairs of accumulators let consecutive vertices be processed independently
+        __m128 min0 = _mm_loadu_ps(&vertices[0].position.x), max0 = min0;
+        __m128 min1 = min0, max1 = min0;
+        size_t index = 1;
+        for(; index + 2 <= count; index += 2){
+            __m128 first = _mm_loadu_ps(&vertices[index].position.x);
+            __m128 second = _mm_loadu_ps(&vertices[index + 1].position.x);
+            min0 = _mm_min_ps(min0, first);
+            max0 = _mm_max_ps(max0, first);
+            min1 = _mm_min_ps(min1, second);
+            max1 = _mm_max_ps(max1, second);
+        }
+        if(index < count){
+            __m128 last = _mm_loadu_ps(&vertices[index].position.x);
+            min0 = _mm_min_ps(min0, last);
+            max0 = _mm_max_ps(max0, last);
+        }
+        alignas(16) float minimum[4], maximum[4];
+        _mm_store_ps(minimum, _mm_min_ps(min0, min1));
+        _mm_store_ps(maximum, _mm_max_ps(max0, max1));
+        box.min = glm::vec3(minimum[0], minimum[1], minimum[2]);
+        box.max = glm::vec3(maximum[0], maximum[1], maximum[2]);
+#else
+        box.min = box.max = vertices[0].position;
+        for(size_t index = 1; index < count; index++){
+            box.min = glm::min(box.min, vertices[index].position);
+            box.max = glm::max(box.max, vertices[index].position);
+        }
+#endif
+        return box;
+    }
+
+    Bounds computeBounds(const Vertex* vertices, size_t count) {
+        Bounds bounds;
+        bounds.box = computeBox(vertices, count);
+        bounds.sphere.center = bounds.box.getCenter();
+        float radiusSquared = 0.0f;
+        for(size_t index = 0; index < count; index++){
+            glm::vec3 offset = vertices[index].position - bounds.sphere.center;
+            radiusSquared = glm::max(radiusSquared, glm::dot(offset, offset));
+        }
+        bounds.sphere.radius = glm::sqrt(radiusSquared);
+        return bounds;
+    }
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "vertex.hpp"
+#include <glm/glm.hpp>
+#include <cstddef>
+
+namespace our {
+
+    // An axis aligned bounding box
+    struct BoundingBox {
+        glm::vec3 min = glm::vec3(0.0f), max = glm::vec3(0.0f);
+
+        glm::vec3 getCenter() const { return (min + max) * 0.5f; }
+        glm::vec3 getExtents() const { return (max - min) * 0.5f; } // The half size of the box on each axis
+
+        // Returns the axis aligned box containing this box after it is transformed by the given matrix (e.g. an entity's local to world matrix)
+        // Each world axis gets the absolute projections of the local extents, so the result is tight for boxes.
+        BoundingBox transform(const glm::mat4& matrix) const {
+            glm::vec3 center = glm::vec3(matrix * glm::vec4(getCenter(), 1.0f));
+            glm::mat3 absolute = glm::mat3(matrix);
+            for(int column = 0; column < 3; column++) absolute[column] = glm::abs(absolute[column]);
+            glm::vec3 extents = absolute * getExtents();
+            return { center - extents, center + extents };
+        }
+    };
+
+    // A bounding sphere
+    struct BoundingSphere {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+
+        // Returns the sphere containing this sphere after it is transformed by the given matrix
+        // With a non uniform scale, the radius is scaled by the largest scale so the sphere still contains the object.
+        BoundingSphere transform(const glm::mat4& matrix) const {
+            float scale = glm::sqrt(glm::max(glm::max(
+                glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+                glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1]))),
+                glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))));
+            return { glm::vec3(matrix * glm::vec4(center, 1.0f)), radius * scale };
+        }
+    };
+
+    // The bounding volumes of a mesh in its local space
+    struct Bounds {
+        BoundingBox box;
+        BoundingSphere sphere; // Centered on the box center
+
+        Bounds transform(const glm::mat4& matrix) const { return { box.transform(matrix), sphere.transform(matrix) }; }
+    };
+
+    // Computes the bounds of the vertex positions
+    // The box is found by a min/max pass that handles a whole position per SIMD instruction (if SSE is available).
+    // The sphere is centered on the box and its radius reaches the farthest vertex.
+    Bounds computeBounds(const Vertex* vertices, size_t count);
+
+}
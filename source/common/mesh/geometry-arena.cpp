@@ -0,0 +1,186 @@
+#include "geometry-arena.hpp"
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <initializer_list>
+
+namespace our {
+
+    // The starting sizes of the buffers (about 2.3MB of vertices & 1MB of elements). They double every time they are full.
+    static constexpr uint32_t INITIAL_VERTICES = 1 << 16, INITIAL_INDICES = 1 << 18;
+
+    uint32_t RangeAllocator::allocate(uint32_t size) {
+        if(size == 0) return 0;
+        for(auto block = freeBlocks.begin(); block != freeBlocks.end(); ++block) {
+            if(block->second < size) continue;
+            uint32_t offset = block->first, remaining = block->second - size;
+            freeBlocks.erase(block);
+            if(remaining > 0) freeBlocks.emplace(offset + size, remaining);
+            used += size;
+            return offset;
+        }
+        return NONE;
+    }
+
+    void RangeAllocator::free(uint32_t offset, uint32_t size) {
+        if(size == 0) return;
+        used -= size;
+        // Merge with the free block right after the range, then with the one right before it
+        auto next = freeBlocks.lower_bound(offset);
+        if(next != freeBlocks.end() && offset + size == next->first) {
+            size += next->second;
+            next = freeBlocks.erase(next);
+        }
+        if(next != freeBlocks.begin()) {
+            auto previous = std::prev(next);
+            if(previous->first + previous->second == offset) {
+                previous->second += size;
+                return;
+            }
+        }
+        freeBlocks.emplace(offset, size);
+    }
+
+    void RangeAllocator::grow(uint32_t newCapacity) {
+        if(newCapacity <= capacity) return;
+        uint32_t extra = newCapacity - capacity;
+        if(!freeBlocks.empty()) {
+            auto last = std::prev(freeBlocks.end());
+            if(last->first + last->second == capacity) last->second += extra;
+            else freeBlocks.emplace(capacity, extra);
+        } else freeBlocks.emplace(capacity, extra);
+        capacity = newCapacity;
+    }
+
+    GeometryArena& GeometryArena::get() {
+        static GeometryArena arena;
+        return arena;
+    }
+
+    void GeometryArena::create() {
+        glGenVertexArrays(1, &vertexArray);
+        glGenVertexArrays(1, &instancedVertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &elementBuffer);
+        // The buffers are only given a size here, the meshes fill their ranges later
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)INITIAL_VERTICES * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)INITIAL_INDICES * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        vertexRanges.grow(INITIAL_VERTICES);
+        indexRanges.grow(INITIAL_INDICES);
+        setupVertexArrays();
+    }
+
+    void GeometryArena::destroy() {
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteVertexArrays(1, &instancedVertexArray);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &elementBuffer);
+        vertexArray = instancedVertexArray = vertexBuffer = elementBuffer = 0;
+        vertexRanges.reset();
+        indexRanges.reset();
+    }
+
+    uint32_t GeometryArena::allocateRange(RangeAllocator& ranges, GLuint& buffer, size_t stride, uint32_t size) {
+        uint32_t offset = ranges.allocate(size);
+        if(offset != RangeAllocator::NONE) return offset;
+
+        // The new buffer is at least twice as big, so growing many times costs about as much as copying the data once
+        uint32_t oldCapacity = ranges.getCapacity();
+        uint32_t newCapacity = std::max(oldCapacity * 2, oldCapacity + size);
+        GLuint grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)newCapacity * stride, nullptr, GL_STATIC_DRAW);
+        if(buffer) {
+            // The old data is copied on the GPU, so the offsets of the allocated ranges stay valid
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)oldCapacity * stride);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        buffer = grown;
+        ranges.grow(newCapacity);
+        setupVertexArrays();
+        // The free space at the end is now at least "size" long, so this can't fail
+        return ranges.allocate(size);
+    }
+
+    void GeometryArena::setupVertexArrays() {
+        for(GLuint array : { vertexArray, instancedVertexArray }) {
+            glBindVertexArray(array);
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            // void glVertexAttribPointer(index, size <= number of components, type, normalized, stride <= sizeof(Vertex), pointer <= offset of the attribute)
+            // The offsets are from the start of the buffer, the base vertex of each draw moves them to the mesh's range
+            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, position));
+            // The color is 4 bytes that are normalized to [0, 1]
+            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4, GL_UNSIGNED_BYTE, true, sizeof(Vertex), (void*)offsetof(Vertex, color));
+            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, tex_coord));
+            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, false, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+            // The element buffer binding is part of the vertex array state
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+        }
+        // The instance attributes advance once per instance. Their pointers are set by each instanced draw (see "Mesh::setInstanceData").
+        glBindVertexArray(instancedVertexArray);
+        for(GLuint location = ATTRIB_LOC_INSTANCE_M; location < ATTRIB_LOC_INSTANCE_M_IT + 4; location++) {
+            glEnableVertexAttribArray(location);
+            glVertexAttribDivisor(location, 1);
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GeometryAllocation GeometryArena::allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements) {
+        if(meshes == 0) create();
+        meshes++;
+        GeometryAllocation allocation;
+        allocation.vertexCount = (uint32_t)vertices.size();
+        allocation.indexCount = (uint32_t)elements.size();
+        allocation.baseVertex = allocateRange(vertexRanges, vertexBuffer, sizeof(Vertex), allocation.vertexCount);
+        allocation.firstIndex = allocateRange(indexRanges, elementBuffer, sizeof(unsigned int), allocation.indexCount);
+        // The data is written through GL_COPY_WRITE_BUFFER so that the element buffer of the bound vertex array doesn't change
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.baseVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, elementBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)allocation.firstIndex * sizeof(unsigned int), elements.size() * sizeof(unsigned int), elements.data());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return allocation;
+    }
+
+    void GeometryArena::free(const GeometryAllocation& allocation) {
+        if(meshes == 0) return;
+        vertexRanges.free(allocation.baseVertex, allocation.vertexCount);
+        indexRanges.free(allocation.firstIndex, allocation.indexCount);
+        if(--meshes == 0) destroy();
+    }
+
+    void GeometryArena::read(const GeometryAllocation& allocation, std::vector<Vertex>& vertices, std::vector<unsigned int>& elements) const {
+        vertices.resize(allocation.vertexCount);
+        elements.resize(allocation.indexCount);
+        glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)allocation.baseVertex * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, elementBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)allocation.firstIndex * sizeof(unsigned int), elements.size() * sizeof(unsigned int), elements.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    }
+
+    GeometryArenaStats GeometryArena::getStats() const {
+        GeometryArenaStats stats;
+        stats.meshes = meshes;
+        stats.vertices = vertexRanges.getUsed();
+        stats.vertexCapacity = vertexRanges.getCapacity();
+        stats.indices = indexRanges.getUsed();
+        stats.indexCapacity = indexRanges.getCapacity();
+        stats.freeBlocks = vertexRanges.getFreeBlockCount() + indexRanges.getFreeBlockCount();
+        return stats;
+    }
+
+}
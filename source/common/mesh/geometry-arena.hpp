@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/gl.h>
+#include "vertex.hpp"
+#include <vector>
+#include <map>
+#include <cstdint>
+#include <cstddef>
+
+namespace our {
+
+    // Hands out ranges of a buffer (offsets & sizes are in elements, not bytes) with a first fit free list.
+    // The free blocks are kept sorted by offset so that a freed range is merged with the free blocks next to it.
+    class RangeAllocator {
+        std::map<uint32_t, uint32_t> freeBlocks; // offset -> size
+        uint32_t capacity = 0, used = 0;
+    public:
+        static constexpr uint32_t NONE = ~0u;
+
+        // Returns the offset of a free range of the given size or NONE if no free block is big enough
+        uint32_t allocate(uint32_t size);
+        void free(uint32_t offset, uint32_t size);
+        // Adds the space between the old and the new capacity at the end (the allocated ranges don't move)
+        void grow(uint32_t newCapacity);
+        void reset() { freeBlocks.clear(); capacity = used = 0; }
+
+        uint32_t getCapacity() const { return capacity; }
+        uint32_t getUsed() const { return used; }
+        size_t getFreeBlockCount() const { return freeBlocks.size(); }
+    };
+
+    // The ranges of the arena buffers given to one mesh
+    struct GeometryAllocation {
+        uint32_t baseVertex = 0, vertexCount = 0; // The elements are relative to the base vertex
+        uint32_t firstIndex = 0, indexCount = 0;
+    };
+
+    // The sizes of the arena (shown in the stats window)
+    struct GeometryArenaStats {
+        size_t meshes = 0;
+        size_t vertices = 0, vertexCapacity = 0;
+        size_t indices = 0, indexCapacity = 0;
+        size_t freeBlocks = 0; // The free blocks of both buffers (many small blocks mean the buffers are fragmented)
+    };
+
+    // Stores the vertices & the elements of all the meshes in one vertex buffer and one element buffer.
+    // Every mesh has the same vertex format (Vertex), so they all share a single vertex array and a mesh is drawn
+    // with glDrawElementsBaseVertex from its own ranges. Switching between meshes doesn't need any bind.
+    // The instanced draws use a second vertex array over the same buffers that also has the per-instance attributes enabled,
+    // so the instance attributes never stay enabled (with a divisor) on the vertex array of the regular draws.
+    // When a buffer is full, it is replaced by a buffer twice as big and the old data is copied on the GPU.
+    // The GL objects are created with the first mesh and deleted with the last one (so nothing is left when the assets are cleared).
+    class GeometryArena {
+        GLuint vertexArray = 0, instancedVertexArray = 0, vertexBuffer = 0, elementBuffer = 0;
+        RangeAllocator vertexRanges, indexRanges;
+        size_t meshes = 0;
+
+        GeometryArena() = default;
+
+        void create();
+        void destroy();
+        // Allocates "size" elements of "stride" bytes from the ranges of "buffer". If they don't fit,
+        // the buffer is replaced by a bigger one (so its name changes) and the vertex array is pointed to it.
+        uint32_t allocateRange(RangeAllocator& ranges, GLuint& buffer, size_t stride, uint32_t size);
+        // Points the vertex arrays to the current buffers (needed after a buffer is replaced)
+        void setupVertexArrays();
+
+    public:
+        // The arena is shared by every mesh (like the GL state, there is one per context)
+        static GeometryArena& get();
+
+        GeometryAllocation allocate(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements);
+        void free(const GeometryAllocation& allocation);
+        // Reads the data of an allocation back from the buffers (this waits for the GPU, so it is only meant for load time work)
+        void read(const GeometryAllocation& allocation, std::vector<Vertex>& vertices, std::vector<unsigned int>& elements) const;
+
+        // The instanced vertex array is only used with "Mesh::setInstanceData" (which points its instance attributes to the instance data)
+        void bind(bool instanced = false) const { glBindVertexArray(getVertexArray(instanced)); }
+        GLuint getVertexArray(bool instanced = false) const { return instanced ? instancedVertexArray : vertexArray; }
+        GeometryArenaStats getStats() const;
+
+        GeometryArena(const GeometryArena&) = delete;
+        GeometryArena& operator=(const GeometryArena&) = delete;
+    };
+
+}
@@ -2,6 +2,8 @@
 
 #include <glad/gl.h>
 #include "vertex.hpp"
+#include "bounds.hpp"
+#include "geometry-arena.hpp"
 
 namespace our {
 
@@ -9,109 +11,48 @@ namespace our {
     #define ATTRIB_LOC_COLOR    1
     #define ATTRIB_LOC_TEXCOORD 2
     #define ATTRIB_LOC_NORMAL   3
+    // The per-instance attributes of the instanced draws (each mat4 takes 4 locations, one per column)
+    #define ATTRIB_LOC_INSTANCE_M    4
+    #define ATTRIB_LOC_INSTANCE_M_IT 8
+
+    // The data of one instance of an instanced draw (the model matrix & its inverse transpose)
+    struct InstanceData {
+        glm::mat4 M, M_IT;
+    };
 
     class Mesh {
-        // Here, we store the object names of the 3 main components of a mesh:
-        // A vertex array object, A vertex buffer and an element buffer
-        unsigned int VBO, EBO;
-        unsigned int VAO;
+        // Instead of its own vertex array, vertex buffer & element buffer, each mesh gets a range of the shared buffers
+        // of the geometry arena (see "GeometryArena"), so every mesh is drawn with the same vertex array
+        GeometryAllocation allocation;
         // We need to remember the number of elements that will be draw by glDrawElements 
         GLsizei elementCount;
+        // A number that identifies this mesh (given in the order of creation). The renderer sorts the draws by it.
+        uint32_t id;
+        // The bounding box & sphere of the vertex positions in the mesh's local space
+        Bounds bounds;
+
+        static uint32_t nextId() { static uint32_t count = 0; return count++; }
     public:
 
         // The constructor takes two vectors:
         // - vertices which contain the vertex data.
         // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
-        // The mesh class does not keep a these data on the RAM. Instead, it should create
-        // a vertex buffer to store the vertex data on the VRAM,
-        // an element buffer to store the element data on the VRAM,
-        // a vertex array object to define how to read the vertex & element buffer during rendering 
+        // The mesh class does not keep a these data on the RAM. Instead, it copies them
+        // to its ranges of the arena's vertex buffer & element buffer on the VRAM.
+        // The elements stay relative to the mesh's first vertex since the draws add the base vertex to them.
         Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements)
         {
             //TODO: (Req 2) Write this function
             // remember to store the number of elements in "elementCount" since you will need it for drawing
-            // For the attribute locations, use the constants defined above: ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc
-            
-            //for vertex_array & vertex_buffer & element_buffer below , we specified the number of the array/buffer object -first parameter- to be generated to be only 1 -for each array/buffer-
-            //for the second parameter we send the address to the array/buffer object (defined above)
-            //then we bind each array/buffer 
-
-            // vertex_array 
-            glGenVertexArrays(1, &VAO);
-            glBindVertexArray(VAO);
-
+            // The vertex array (with the attribute locations ATTRIB_LOC_POSITION, ATTRIB_LOC_COLOR, etc) is set up by the arena
+            allocation = GeometryArena::get().allocate(vertices, elements);
+            id = nextId();
 
-            // vertex_buffer:
-
-            // void glBufferData(	
-            //    GLenum target, <= here we specify the target to which the buffer object is bound for , whish is here "GL_ARRAY_BUFFER"
-            //     GLsizeiptr size,  <= we multiply with "sizeof( Vertex)" as vertices defined as "std::vector<Vertex>"
-            //     const void * data, <= the data of the vertices
-            //     GLenum usage <= we use "GL_STATIC_DRAW" as we are not going to change contents of buffer often
-            // );
-            glGenBuffers(1, &VBO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size()* sizeof(Vertex) , vertices.data(), GL_STATIC_DRAW);
-        
-            // void glVertexAttribPointer(	
-            //     GLuint index,
-            //     GLint size, <= The number of components per attribute
-            //     GLenum type, <=The data type of each component of the color vector
-            //     GLboolean normalized, <=Whether the data should be normalized before being passed to the shader program or not
-            //     GLsizei stride, <=Specifies the byte offset between consecutive generic vertex attributes(This tells OpenGL how much memory to skip to get to the next vertex's normal data)
-            //     const void * pointer <= The offset in bytes from the start of each vertex to the specific attribute
-            // );
-
-            // position_loc  
-            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
-            //ATTRIB_LOC_POSITION: is the location of the position attribute in the shader program
-            //3: the position is represented as a 3-component vector (xyz)
-            //false: means that the data should not be normalized before it is used#pragma endregion
-            //sizeof(Vertex) specifies the size of each vertex in bytes
-            //last parameter : specifies the offset from the beginning of each vertex to the start of its position data (which is 0 since it's at the beginning)
-            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, false, sizeof(Vertex), (void*)0);
-            
-
-            // color_loc :
-            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
-            //ATTRIB_LOC_TEXCOORD: is the location of the attribute in the shader program.
-            //4: the color is represented as a 4-component vector (RGBA)
-            //GL_UNSIGNED_BYTE: color components are stored as unsigned bytes.
-            //true: In this case, the color components are normalized to the range [0, 1] before being passed.
-            glVertexAttribPointer(ATTRIB_LOC_COLOR, 4,  GL_UNSIGNED_BYTE, true, sizeof(Vertex),  (void*)offsetof(Vertex, color));
-        
-
-            //tex coord
-            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
-            //2: specifies that there are two components (u and v) in each texture coordinate
-            //GL_FLOAT :each component is a floating-point value.
-            //last parameter specifies the offset from the beginning of a vertex to its texture coordinate data
-            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT , false, sizeof(Vertex),  (void*)offsetof(Vertex, tex_coord));    
-        
-
-            //normal
-            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
-            //ATTRIB_LOC_NORMAL: is an integer constant that represents the location index of the normal attribute in the shader program
-            //3 : specifies that each normal vector has three components (x, y, z)
-            //GL_FLOAT: indicates that each component is a floating-point value. 
-            //false: means that the data should not be normalized before it is used#pragma endregion
-            //last parameter: specifies the offset from the beginning of a Vertex struct to its normal member variable. This tells OpenGL where to find the first normal vector in memory for a given vertex.
-            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3,  GL_FLOAT, false, sizeof(Vertex),  (void*)offsetof(Vertex, normal));
-        
-            // element_buffer:
-
-            // void glBufferData(	
-            //    GLenum target, <= here we specify the target to which the buffer object is bound for , whish is here "GL_ELEMENT_ARRAY_BUFFER"
-            //     GLsizeiptr size,  <= we multiply with "sizeof( unsigned int)" as elements defined as "std::vector<unsigned int>"
-            //     const void * data, <= the data of the elements
-            //     GLenum usage <= we use "GL_STATIC_DRAW" as we are not going to change contents of buffer often
-            // );
-            glGenBuffers(1, &EBO);
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size()*sizeof( unsigned int), elements.data(), GL_STATIC_DRAW);  
-        
             // set elementCount
             elementCount=(GLsizei)elements.size();
+
+            // The vertices are not kept on the RAM, so the bounds are computed now
+            bounds = computeBounds(vertices.data(), vertices.size());
             
         }
 
@@ -127,19 +68,57 @@ namespace our {
             //   const void * indices <=  Since we are starting at the beginning of the index buffer, we pass 0 as the offset
             // );
 
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void*)0);
+            bind();
+            drawBound();
+        }
+
+        // Binds the vertex array of the mesh (it is the arena's vertex array, which is the same for all the meshes)
+        // The instanced draws bind the arena's instanced vertex array instead (see "setInstanceData")
+        void bind(bool instanced = false) const { GeometryArena::get().bind(instanced); }
+        // Draws the mesh assuming that its vertex array is already bound (the renderer skips the bind between draws)
+        // The offset of the first element is in bytes & the base vertex is added to every element
+        void drawBound() const {
+            glDrawElementsBaseVertex(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT,
+                (void*)(allocation.firstIndex * sizeof(unsigned int)), (GLint)allocation.baseVertex);
         }
+        // Reads the vertices & the elements back from the arena. This waits for the GPU, so it is only meant for load time work
+        // (e.g. the static batching).
+        void readBack(std::vector<Vertex>& vertices, std::vector<unsigned int>& elements) const {
+            GeometryArena::get().read(allocation, vertices, elements);
+        }
+        // Draws the given number of instances assuming that the vertex array is bound & points to the instance data
+        void drawInstancedBound(GLsizei instances) const {
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT,
+                (void*)(allocation.firstIndex * sizeof(unsigned int)), instances, (GLint)allocation.baseVertex);
+        }
+        // Points the per-instance attributes of the vertex array to the InstanceData array at "offset" (in bytes) in "buffer"
+        // OpenGL 3.3 can't start an instanced draw from a base instance, so each draw moves the attributes to its part of the buffer.
+        // The instanced vertex array must be bound ("bind(true)"). The instance attributes are only enabled on that vertex array,
+        // so the regular draws never see them.
+        void setInstanceData(GLuint buffer, size_t offset) const {
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            for(GLuint column = 0; column < 4; column++){
+                GLuint locations[2] = { ATTRIB_LOC_INSTANCE_M + column, ATTRIB_LOC_INSTANCE_M_IT + column };
+                size_t offsets[2] = { offsetof(InstanceData, M), offsetof(InstanceData, M_IT) };
+                for(int matrix = 0; matrix < 2; matrix++){
+                    glVertexAttribPointer(locations[matrix], 4, GL_FLOAT, false, sizeof(InstanceData),
+                        (void*)(offset + offsets[matrix] + column * sizeof(glm::vec4)));
+                }
+            }
+        }
+        // Returns the OpenGL name of the vertex array (the renderer only binds it when it changes)
+        GLuint getVertexArray(bool instanced = false) const { return GeometryArena::get().getVertexArray(instanced); }
+        // Returns a number that identifies this mesh (the renderer sorts the draws by it)
+        uint32_t getId() const { return id; }
 
-        // this function should delete the vertex & element buffers and the vertex array object
+        // Returns the bounding volumes of the mesh in its local space
+        // Use "Bounds::transform" with an entity's local to world matrix to get them in the world space.
+        const Bounds& getBounds() const { return bounds; }
+
+        // this function should give the ranges back to the arena
         ~Mesh(){
             //TODO: (Req 2) Write this function
-
-            //for all buffers below , we specified the number of the array object -first parameter- to be deleted to be only 1 -for each buffer-
-            //for the second parameter we send the address to the array object (defined above)
-            glDeleteVertexArrays(1, &VAO);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
+            GeometryArena::get().free(allocation);
         }
 
         Mesh(Mesh const &) = delete;
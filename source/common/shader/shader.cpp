@@ -4,6 +4,8 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
+#include <utility>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
@@ -123,7 +125,7 @@ Description
 
 
 
-bool our::ShaderProgram::link() const {
+bool our::ShaderProgram::link() {
     /*
     Name
      glLinkProgram — Links a program object
@@ -146,6 +148,48 @@ bool our::ShaderProgram::link() const {
         return false;
     }
 
+    // Connect the shared uniform blocks declared by the program to their binding points
+    static const std::pair<const char*, UniformBlock> sharedBlocks[] = {
+        { "Lighting", UniformBlock::LIGHTING }
+    };
+    for(auto& [name, binding] : sharedBlocks){
+        GLuint index = glGetUniformBlockIndex(program, name);
+        if(index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, (GLuint)binding);
+    }
+
+    // The locations are read once here, so setting a uniform never queries OpenGL
+    uniformLocations.clear();
+    auto addLocation = [this](const std::string& name, GLint location){
+        if(location < 0) return;
+        auto [it, inserted] = uniformLocations.emplace(UniformName(name).getHash(), location);
+        if(!inserted && it->second != location)
+            std::cerr << "WARNING: The name of the uniform " << name << " has the same hash as another uniform" << std::endl;
+    };
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string buffer(std::max(maxLength, 1), '\0');
+    for(GLint index = 0; index < count; index++){
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveUniform(program, index, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+        std::string name = buffer.substr(0, length);
+        // An array of a basic type is listed once as "name[0]". Every element gets an entry and the array name refers to the first one.
+        // (The members of an array of structures are listed separately, e.g. "lights[1].type", so they don't need this.)
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+            std::string base = name.substr(0, name.size() - 3);
+            addLocation(base, glGetUniformLocation(program, name.c_str()));
+            for(GLint element = 0; element < size; element++){
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                addLocation(elementName, glGetUniformLocation(program, elementName.c_str()));
+            }
+        } else {
+            // The uniforms inside a uniform block have no location, so they are skipped by "addLocation"
+            addLocation(name, glGetUniformLocation(program, name.c_str()));
+        }
+    }
+
     return true;
       //TODO: Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
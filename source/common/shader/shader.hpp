@@ -2,18 +2,68 @@
 #define SHADER_HPP
 
 #include <string>
+#include <unordered_map>
+#include <cstdint>
 
 #include <glad/gl.h>
+#include "../gl-state.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace our {
 
+    // The name of a uniform stored as its hash (64-bit FNV-1a)
+    // The constructor is constexpr, so a name can be hashed at compile time (e.g. "static constexpr UniformName TINT("tint");")
+    // and the shader looks the location up by hash without touching a string.
+    class UniformName {
+        static constexpr uint64_t OFFSET = 14695981039346656037ull, PRIME = 1099511628211ull;
+        uint64_t hash;
+
+        constexpr explicit UniformName(uint64_t hash, int) : hash(hash) {}
+
+        static constexpr uint64_t append(uint64_t hash, const char* text) {
+            while(*text) hash = (hash ^ (uint8_t)*text++) * PRIME;
+            return hash;
+        }
+        static constexpr uint64_t append(uint64_t hash, uint32_t number) {
+            uint32_t divisor = 1;
+            while(number / divisor >= 10) divisor *= 10;
+            for(; divisor > 0; divisor /= 10) hash = (hash ^ (uint8_t)('0' + (number / divisor) % 10)) * PRIME;
+            return hash;
+        }
+    public:
+        constexpr UniformName(const char* name) : hash(append(OFFSET, name)) {}
+        UniformName(const std::string& name) : hash(append(OFFSET, name.c_str())) {}
+
+        // Returns the name of an array element or of a member of an array element
+        // e.g. element("lights", 3, "direction") is the same as "lights[3].direction" and element("weights", 2) is "weights[2]".
+        static constexpr UniformName element(const char* array, uint32_t index, const char* member = nullptr) {
+            uint64_t hash = append(append(append(OFFSET, array), "["), index);
+            hash = append(hash, "]");
+            if(member) hash = append(append(hash, "."), member);
+            return UniformName(hash, 0);
+        }
+
+        constexpr uint64_t getHash() const { return hash; }
+    };
+
+    // The binding points of the uniform blocks shared by many programs
+    // When a program is linked, each of these blocks that it declares is connected to its binding point,
+    // so a buffer bound once to that point is read by every program.
+    enum class UniformBlock : GLuint {
+        LIGHTING = 0 // "Lighting" (the lights & the sky, see "lighted.frag")
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
+        // The locations of the active uniforms indexed by the hash of their names (filled by "link")
+        // Each element of an array (and each member of an element of an array of structures) has its own entry.
+        std::unordered_map<uint64_t, GLint> uniformLocations;
+        // The variant of this program that reads the model matrices from per-instance attributes (not owned, see the asset loader)
+        ShaderProgram* instanced = nullptr;
 
     public:
         ShaderProgram(){
@@ -33,18 +83,28 @@ namespace our {
             Program objects can be deleted by calling glDeleteProgram().
              The memory associated with the program object will be deleted when it is no longer part of current rendering state for any context.
             */
-            if(program) // check if there is a shader program then delete it 
-            glDeleteProgram(program); 
+            if(program){ // check if there is a shader program then delete it 
+                GLState::get().forgetProgram(program);
+                glDeleteProgram(program); 
+            }
 
         }
 
         bool attach(const std::string &filename, GLenum type) const;
 
-        bool link() const;
+        // Links the program then reads the locations of all its active uniforms (see "getUniformLocation")
+        bool link();
 
         void use() { 
-            glUseProgram(program);
+            GLState::get().useProgram(program);
         }
+
+        // Returns the OpenGL name of the program (also used by the renderer to sort draws by shader)
+        GLuint getOpenGLName() const { return program; }
+
+        // The renderer draws repeated objects with the instanced variant (if the program has one) using a single draw call
+        void setInstanced(ShaderProgram* variant) { instanced = variant; }
+        ShaderProgram* getInstanced() const { return instanced; }
         /*
         glGetUniformLocation — Returns the location of a uniform variable
 
@@ -250,44 +310,51 @@ namespace our {
                 4-value : For the vector and matrix commands, specifies a pointer to an array of count values that will be used to update 
                 the specified uniform variable.
         */
-        GLuint getUniformLocation(const std::string &name) {
+        // Returns the location of the uniform from the table filled at link time (no OpenGL query and no allocation)
+        // Like glGetUniformLocation, it returns -1 if the program has no active uniform with this name (setting it does nothing).
+        GLint getUniformLocation(UniformName name) const {
             //TODO: (Req 1) Return the location of the uniform with the given name
-            return glGetUniformLocation(program,name.c_str());
-
+            auto it = uniformLocations.find(name.getHash());
+            return it == uniformLocations.end() ? -1 : it->second;
         }
 
-        void set(const std::string &uniform, GLfloat value) {
+        void set(UniformName uniform, GLfloat value) {
             //TODO: (Req 1) Send the given float value to the given uniform
             glUniform1f(getUniformLocation(uniform),value);
         }
 
-        void set(const std::string &uniform, GLuint value) {
+        void set(UniformName uniform, GLuint value) {
             //TODO: (Req 1) Send the given unsigned integer value to the given uniform
             glUniform1ui(getUniformLocation(uniform),value);
         }
 
-        void set(const std::string &uniform, GLint value) {
+        void set(UniformName uniform, GLint value) {
             //TODO: (Req 1) Send the given integer value to the given uniform
             glUniform1i(getUniformLocation(uniform),value);
 
         }
 
-        void set(const std::string &uniform, glm::vec2 value) {
+        // Sends "count" integers to an array uniform starting from its first element (the name of the array is enough)
+        void set(UniformName uniform, const GLint* values, GLsizei count) {
+            glUniform1iv(getUniformLocation(uniform), count, values);
+        }
+
+        void set(UniformName uniform, glm::vec2 value) {
             //TODO: (Req 1) Send the given 2D vector value to the given uniform
              glUniform2f(getUniformLocation(uniform), value.x, value.y);
         }
  
-        void set(const std::string &uniform, glm::vec3 value) {
+        void set(UniformName uniform, glm::vec3 value) {
             //TODO: (Req 1) Send the given 3D vector value to the given uniform
              glUniform3f(getUniformLocation(uniform), value.x, value.y, value.z);
         }
 
-        void set(const std::string &uniform, glm::vec4 value) {
+        void set(UniformName uniform, glm::vec4 value) {
             //TODO: (Req 1) Send the given 4D vector value to the given uniform
             glUniform4f(getUniformLocation(uniform), value.x, value.y, value.z, value.w);
         }
 
-        void set(const std::string &uniform, glm::mat4 matrix) {
+        void set(UniformName uniform, glm::mat4 matrix) {
             //TODO: (Req 1) Send the given matrix 4x4 value to the given uniform
             glUniformMatrix4fv(getUniformLocation(uniform), 1, false, glm::value_ptr(matrix));
         }
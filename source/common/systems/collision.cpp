@@ -0,0 +1,283 @@
+#include "collision.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../deserialize-utils.hpp"
+
+#include <algorithm>
+
+namespace our {
+
+    CollisionSystem::CollisionSystem() {
+        layerMasks.fill(~uint32_t(0));
+        categoryExtents.fill(glm::vec3(0.0f));
+    }
+
+    void CollisionSystem::initialize(const nlohmann::json& config, World* world) {
+        clear();
+        layerMasks.fill(~uint32_t(0));
+        categoriesWithExtents = 0;
+        mode = CollisionMode::SPATIAL_HASH;
+        if(config.is_object()) readConfig(config);
+        // The collidables that already exist are added with a single scan. After that, the grid only follows the changes.
+        // The bounds are computed from the resolved world matrices, so the transforms of the loaded entities are resolved first.
+        this->world = world;
+        world->updateTransforms();
+        feed = world->watch<CollisionComponent>();
+        feed->changes.clear();
+        bulkLoading = true;
+        world->view<CollisionComponent>().each([this](Entity* entity, CollisionComponent&){ refresh(entity->getHandle()); });
+        bulkLoading = false;
+        if(mode == CollisionMode::SWEEP_AND_PRUNE) rebuildSorted(true);
+        stats.proxies = proxies.size();
+        stats.cells = cells.size();
+    }
+
+    void CollisionSystem::readConfig(const nlohmann::json& config) {
+        mode = config.value("mode", "spatial-hash") == "sweep-and-prune" ? CollisionMode::SWEEP_AND_PRUNE : CollisionMode::SPATIAL_HASH;
+        cellSize = std::max(config.value("cellSize", cellSize), 0.01f);
+        // The names are interned here once, so the systems only deal with the category IDs
+        if(auto it = config.find("categories"); it != config.end() && it->is_object()){
+            for(auto& [name, category] : it->items()){
+                if(!category.is_object() || !category.contains("extents")) continue;
+                CollisionCategory id = internCollisionCategory(name);
+                categoryExtents[id] = category.value("extents", glm::vec3(0.0f));
+                categoriesWithExtents |= getCollisionLayer(id);
+            }
+        }
+        if(auto it = config.find("layers"); it != config.end() && it->is_object()){
+            for(auto& [name, others] : it->items()){
+                uint32_t mask = 0;
+                for(auto& other : others) mask |= getCollisionLayer(internCollisionCategory(other.get<std::string>()));
+                layerMasks[internCollisionCategory(name)] = mask;
+            }
+        }
+    }
+
+    // The extents of the component come first, then the extents of its category.
+    // Otherwise, the box is the bounds of the mesh transformed to the world space (or just the entity position if it has no mesh).
+    void CollisionSystem::computeBounds(Entity* entity, const CollisionComponent& collision, const glm::mat4& matrix, glm::vec2& min, glm::vec2& max) const {
+        glm::vec3 center = matrix[3], halfExtents(0.0f);
+        if(collision.hasExtents){
+            halfExtents = collision.halfExtents;
+        } else if(categoriesWithExtents & getCollisionLayer(collision.category)){
+            halfExtents = categoryExtents[collision.category];
+        } else if(auto renderer = entity->getComponent<MeshRendererComponent>(); renderer && renderer->mesh){
+            BoundingBox box = renderer->mesh->getBounds().box.transform(matrix);
+            center = box.getCenter();
+            halfExtents = box.getExtents();
+        }
+        min = glm::vec2(center.x - halfExtents.x, center.z - halfExtents.z);
+        max = glm::vec2(center.x + halfExtents.x, center.z + halfExtents.z);
+    }
+
+    void CollisionSystem::clear() {
+        world = nullptr;
+        feed = nullptr;
+        proxies.clear();
+        proxyIndices.clear();
+        cells.clear();
+        sorted.clear();
+        holes = 0;
+        maxLength = 0;
+        cursor = 0;
+        stats = CollisionStats();
+    }
+
+    void CollisionSystem::insertIntoCells(uint32_t index) {
+        if(mode != CollisionMode::SPATIAL_HASH) return;
+        const Proxy& proxy = proxies[index];
+        for(int x = proxy.minCell.x; x <= proxy.maxCell.x; x++)
+            for(int z = proxy.minCell.y; z <= proxy.maxCell.y; z++)
+                cells[cellKey(x, z)].push_back(index);
+    }
+
+    // The order inside a cell doesn't matter, so the proxy is removed by moving the last one into its place
+    // Empty cells are erased so that the map only holds the occupied cells.
+    void CollisionSystem::removeFromCells(uint32_t index) {
+        if(mode != CollisionMode::SPATIAL_HASH) return;
+        const Proxy& proxy = proxies[index];
+        for(int x = proxy.minCell.x; x <= proxy.maxCell.x; x++){
+            for(int z = proxy.minCell.y; z <= proxy.maxCell.y; z++){
+                auto it = cells.find(cellKey(x, z));
+                if(it == cells.end()) continue;
+                auto& list = it->second;
+                auto position = std::find(list.begin(), list.end(), index);
+                if(position != list.end()){
+                    *position = list.back();
+                    list.pop_back();
+                }
+                if(list.empty()) cells.erase(it);
+            }
+        }
+    }
+
+    // Removes the proxy then moves the last proxy into its slot (renaming it in its cells or in the sorted list)
+    // The entry of the removed proxy in the sorted list becomes a hole, so no other entry moves.
+    void CollisionSystem::removeProxy(uint32_t index) {
+        removeFromCells(index);
+        proxyIndices[proxies[index].handle.index] = 0;
+        if(mode == CollisionMode::SWEEP_AND_PRUNE){
+            sorted[proxies[index].rank].proxy = HOLE;
+            holes++;
+        }
+        uint32_t last = (uint32_t)proxies.size() - 1;
+        if(index != last){
+            Proxy& moved = proxies[last];
+            if(mode == CollisionMode::SWEEP_AND_PRUNE){
+                sorted[moved.rank].proxy = index;
+            } else {
+                for(int x = moved.minCell.x; x <= moved.maxCell.x; x++)
+                    for(int z = moved.minCell.y; z <= moved.maxCell.y; z++)
+                        for(auto& entry : cells[cellKey(x, z)])
+                            if(entry == last) entry = index;
+            }
+            proxies[index] = moved;
+            proxyIndices[moved.handle.index] = index + 1;
+        }
+        proxies.pop_back();
+    }
+
+    // The entry goes after the entries with the same start. The holes closest to that position are searched on both sides,
+    // and the entries between the hole and the position are shifted by one towards the hole. So an insertion near a removed
+    // proxy (e.g. a proxy that moved a little) only moves a few entries. If there is no hole, the entries after the position are shifted.
+    void CollisionSystem::insertSorted(uint32_t index) {
+        Proxy& proxy = proxies[index];
+        float start = proxy.min.y;
+        maxLength = std::max(maxLength, proxy.max.y - proxy.min.y);
+        if(bulkLoading){
+            proxy.rank = (uint32_t)sorted.size();
+            sorted.push_back({ start, index });
+            return;
+        }
+        size_t position = std::upper_bound(sorted.begin(), sorted.end(), start,
+            [](float value, const SortedEntry& entry){ return value < entry.start; }) - sorted.begin();
+        // The entries in [left, right) are not holes
+        size_t left = position, right = position;
+        for(;;){
+            if(left > 0 && sorted[left - 1].proxy == HOLE){
+                // Shift the entries between the hole and the position to the left
+                for(size_t target = left - 1; target + 1 < position; target++){
+                    sorted[target] = sorted[target + 1];
+                    proxies[sorted[target].proxy].rank = (uint32_t)target;
+                }
+                position--;
+                holes--;
+                break;
+            }
+            if(right < sorted.size() && sorted[right].proxy == HOLE){
+                // Shift the entries between the position and the hole to the right
+                for(size_t target = right; target > position; target--){
+                    sorted[target] = sorted[target - 1];
+                    proxies[sorted[target].proxy].rank = (uint32_t)target;
+                }
+                holes--;
+                break;
+            }
+            if(left == 0 && right == sorted.size()){
+                // There is no hole at all, so the list grows
+                sorted.insert(sorted.begin() + position, { start, index });
+                for(size_t target = position + 1; target < sorted.size(); target++)
+                    proxies[sorted[target].proxy].rank = (uint32_t)target;
+                proxy.rank = (uint32_t)position;
+                return;
+            }
+            if(left > 0) left--;
+            if(right < sorted.size()) right++;
+        }
+        sorted[position] = { start, index };
+        proxy.rank = (uint32_t)position;
+    }
+
+    void CollisionSystem::moveSorted(uint32_t index) {
+        Proxy& proxy = proxies[index];
+        float start = proxy.min.y;
+        size_t rank = proxy.rank;
+        maxLength = std::max(maxLength, proxy.max.y - proxy.min.y);
+        if((rank == 0 || sorted[rank - 1].start <= start) && (rank + 1 == sorted.size() || sorted[rank + 1].start >= start)){
+            sorted[rank].start = start;
+            return;
+        }
+        // The old entry becomes a hole, which the insertion reuses if the proxy only moved past a few entries
+        sorted[rank].proxy = HOLE;
+        holes++;
+        insertSorted(index);
+    }
+
+    // Compacting is linear in the size of the list, but it only happens after many removals
+    void CollisionSystem::rebuildSorted(bool sort) {
+        sorted.erase(std::remove_if(sorted.begin(), sorted.end(), [](const SortedEntry& entry){ return entry.proxy == HOLE; }), sorted.end());
+        if(sort) std::stable_sort(sorted.begin(), sorted.end(), [](const SortedEntry& a, const SortedEntry& b){ return a.start < b.start; });
+        holes = 0;
+        maxLength = 0;
+        for(size_t position = 0; position < sorted.size(); position++){
+            Proxy& proxy = proxies[sorted[position].proxy];
+            proxy.rank = (uint32_t)position;
+            maxLength = std::max(maxLength, proxy.max.y - proxy.min.y);
+        }
+        cursor = std::min(cursor, sorted.size());
+    }
+
+    // The entity may have been deleted (and its ID given to a new entity), lost its component or been marked for removal since
+    // it was recorded, so its current state decides what happens to its proxy.
+    void CollisionSystem::refresh(EntityHandle handle) {
+        if(handle.index >= proxyIndices.size()) proxyIndices.resize(handle.index + 1, 0);
+        uint32_t& slot = proxyIndices[handle.index];
+        Entity* entity = world->get(handle);
+        CollisionComponent* collision = (entity && !entity->isMarkedForRemoval()) ? entity->getComponent<CollisionComponent>() : nullptr;
+        if(slot != 0 && proxies[slot - 1].handle != handle){
+            // The proxy belongs to another entity that had the same ID. It is only dropped if that entity is gone.
+            if(world->get(proxies[slot - 1].handle)) return;
+            removeProxy(slot - 1);
+        }
+        if(!collision){
+            if(slot != 0){
+                removeProxy(slot - 1);
+                stats.updated++;
+            }
+            return;
+        }
+        // The proxy is new or its entity moved, so we compute its bounds
+        // The matrix resolved at the start of the step is used, since other systems may be moving entities while this runs
+        glm::vec2 min, max;
+        computeBounds(entity, *collision, entity->getCachedLocalToWorldMatrix(), min, max);
+        glm::ivec2 minCell = cellOf(min), maxCell = cellOf(max);
+        uint32_t layer = getCollisionLayer(collision->category);
+        if(slot == 0){
+            proxies.push_back({ handle, min, max, layer, minCell, maxCell, 0, 0 });
+            slot = (uint32_t)proxies.size();
+            insertIntoCells(slot - 1);
+            if(mode == CollisionMode::SWEEP_AND_PRUNE) insertSorted(slot - 1);
+            stats.updated++;
+            return;
+        }
+        Proxy& proxy = proxies[slot - 1];
+        proxy.layer = layer;
+        bool movedOnZ = proxy.min.y != min.y || proxy.max.y != max.y;
+        proxy.min = min;
+        proxy.max = max;
+        if(mode == CollisionMode::SWEEP_AND_PRUNE && movedOnZ){
+            moveSorted(slot - 1);
+            stats.updated++;
+        }
+        // Only the proxies that crossed a cell border are moved in the grid
+        if(proxy.minCell != minCell || proxy.maxCell != maxCell){
+            removeFromCells(slot - 1);
+            proxy.minCell = minCell;
+            proxy.maxCell = maxCell;
+            insertIntoCells(slot - 1);
+            stats.updated++;
+        }
+    }
+
+    void CollisionSystem::update() {
+        stats.updated = 0;
+        stats.changes = 0;
+        if(!feed) return;
+        stats.changes = feed->changes.size();
+        for(EntityHandle handle : feed->changes) refresh(handle);
+        feed->changes.clear();
+        if(holes > MIN_HOLES_TO_COMPACT && holes * 2 > sorted.size()) rebuildSorted(false);
+        stats.proxies = proxies.size();
+        stats.cells = cells.size();
+    }
+
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+#include "../components/collision.hpp"
+
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+namespace our
+{
+
+    // How the collision system finds the collidables near a query
+    enum class CollisionMode {
+        SPATIAL_HASH,    // A grid over the ground plane. It works for collidables spread in any direction.
+        SWEEP_AND_PRUNE  // A list sorted along the track (z) axis scanned from a cursor that follows the player.
+    };
+
+    // The counters of the collision system (shown in the stats window)
+    struct CollisionStats {
+        size_t proxies = 0;     // The number of collidables in the grid
+        size_t cells = 0;       // The number of grid cells that contain at least one collidable (SPATIAL_HASH only)
+        size_t changes = 0;     // The number of changes read from the world in the last update
+        size_t updated = 0;     // The number of collidables whose cells (or place in the sorted list) changed in the last update
+        size_t candidates = 0;  // The number of collidables tested by the narrow phase in the last query
+    };
+
+    // The collision system keeps every entity with a CollisionComponent in a spatial hash over the ground plane (x & z).
+    // Each collidable is stored in the grid cells its box overlaps. The grid is updated incrementally from the changes that
+    // the world records for the entities with a CollisionComponent (see "World::watch"): a collidable is only moved between cells
+    // if its world matrix changed, and removed when its entity or component is gone. So an update doesn't visit the other collidables.
+    // A query only visits the cells overlapped by the query box, so its cost doesn't grow with the number of collidables.
+    // In the SWEEP_AND_PRUNE mode, the collidables are instead kept sorted by the start of their box on the z axis.
+    // Since the player moves steadily along the track, the cursor only advances past a few collidables per query.
+    // A collidable that moves is only shifted to its new place in the list, and a removed one leaves a hole that is
+    // skipped by the queries (and reused by the next insertions near it) until the holes are compacted.
+    class CollisionSystem {
+        // A collidable as stored in the grid
+        struct Proxy {
+            EntityHandle handle;    // The entity of the collidable (looked up again by the queries in case it was deleted)
+            glm::vec2 min, max;     // The bounds of the box on the ground plane (x, z)
+            uint32_t layer;         // The layer bit of the collidable's category
+            glm::ivec2 minCell, maxCell; // The range of cells that contain this proxy
+            uint32_t rank;          // The position of this proxy's entry in "sorted" (SWEEP_AND_PRUNE only)
+            mutable uint32_t visited; // The query that last tested this proxy (so a proxy in many cells is tested once)
+        };
+
+        World* world = nullptr;      // The world of the collidables
+        ChangeFeed* feed = nullptr;  // The changes to the entities with a CollisionComponent
+        CollisionMode mode = CollisionMode::SPATIAL_HASH;
+        float cellSize = 8;
+        // The layer matrix: the layers that each category collides with (every layer by default)
+        std::array<uint32_t, MAX_COLLISION_CATEGORIES> layerMasks;
+        // The half extents used by the collidables of each category that don't have their own
+        std::array<glm::vec3, MAX_COLLISION_CATEGORIES> categoryExtents;
+        uint32_t categoriesWithExtents = 0; // The layer bits of the categories that have extents in "categoryExtents"
+        std::vector<Proxy> proxies;
+        std::vector<uint32_t> proxyIndices; // The index (plus one) of each entity's proxy indexed by the entity ID (0 if it has none)
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cells; // The proxies in each cell indexed by the packed cell coordinates
+        // An entry of the sorted list. A hole keeps the start of the removed proxy, so the list stays sorted with its holes.
+        struct SortedEntry {
+            float start;    // The "min.y" of the proxy (the start of its box on z)
+            uint32_t proxy; // The index of the proxy or HOLE
+        };
+        std::vector<SortedEntry> sorted; // The proxies sorted by the start of their box on z
+        size_t holes = 0;                // The number of holes in "sorted"
+        bool bulkLoading = false;        // While true, the new proxies are appended to "sorted" and sorted once at the end
+        float maxLength = 0;          // At least the longest box along z (so a scan knows how far before the query a box can start).
+                                      // It only grows as proxies are added or moved, and is recomputed when the holes are compacted.
+        mutable size_t cursor = 0;    // The position in "sorted" of the first proxy that may reach the last query
+        static constexpr uint32_t HOLE = 0xFFFFFFFFu;
+        // The holes are compacted when there are more than this many and they are more than half the list
+        static constexpr size_t MIN_HOLES_TO_COMPACT = 64;
+        mutable uint32_t queryCount = 0;
+        mutable CollisionStats stats;
+
+        static uint64_t cellKey(int x, int z) {
+            return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+        }
+        glm::ivec2 cellOf(glm::vec2 point) const {
+            return glm::ivec2(glm::floor(point / cellSize));
+        }
+
+        void insertIntoCells(uint32_t index);
+        void removeFromCells(uint32_t index);
+        void removeProxy(uint32_t index);
+        // Inserts the entry of the proxy at its place in "sorted" by shifting the entries up to the nearest hole
+        void insertSorted(uint32_t index);
+        // Moves the entry of the proxy after the start of its box changed (only its key changes if it is still in order)
+        void moveSorted(uint32_t index);
+        // Removes the holes from "sorted" (sorting it too if "sort" is true), then recomputes the ranks & "maxLength"
+        void rebuildSorted(bool sort);
+        // Reads the mode, the cell size, the extents of the categories and the layer matrix
+        void readConfig(const nlohmann::json& config);
+        // Adds, moves or removes the proxy of the entity referred to by the handle to match the entity's current state
+        void refresh(EntityHandle handle);
+        // Computes the box of the collidable on the ground plane from its extents (or its mesh bounds) and its world matrix
+        void computeBounds(Entity* entity, const CollisionComponent& collision, const glm::mat4& matrix, glm::vec2& min, glm::vec2& max) const;
+
+        // Returns true if the segment from "from" to "to" touches the box [min, max] (the slab test)
+        // A segment of length zero is a point.
+        static bool segmentHitsBox(glm::vec2 from, glm::vec2 to, glm::vec2 min, glm::vec2 max) {
+            float enter = 0, exit = 1;
+            glm::vec2 direction = to - from;
+            for(int axis = 0; axis < 2; axis++){
+                if(direction[axis] == 0){
+                    if(from[axis] < min[axis] || from[axis] > max[axis]) return false;
+                    continue;
+                }
+                float inverse = 1.0f / direction[axis];
+                float near = (min[axis] - from[axis]) * inverse, far = (max[axis] - from[axis]) * inverse;
+                if(near > far) std::swap(near, far);
+                enter = std::max(enter, near);
+                exit = std::min(exit, far);
+                if(enter > exit) return false;
+            }
+            return true;
+        }
+
+        // Calls "function" for the proxy if it is in one of the layers of "mask" and the segment touches its box,
+        // unless the proxy was already tested by this query
+        template<typename F>
+        void test(const Proxy& proxy, glm::vec2 from, glm::vec2 to, uint32_t mask, F& function) const {
+            if(proxy.visited == queryCount) return;
+            proxy.visited = queryCount;
+            if((proxy.layer & mask) == 0) return;
+            stats.candidates++;
+            if(!segmentHitsBox(from, to, proxy.min, proxy.max)) return;
+            if(Entity* entity = world->get(proxy.handle))
+                if(auto collision = entity->getComponent<CollisionComponent>())
+                    function(entity, *collision);
+        }
+
+    public:
+        CollisionSystem();
+
+        // Reads the settings from the scene config then fills the grid with the collidables of the world. Example:
+        // { "mode": "sweep-and-prune", "cellSize": 8, "categories": { "penalty": { "extents": [0.2, 1, 2] } }, "layers": { "player": ["penalty"] } }
+        // "layers" lists the categories each category collides with. A category that is not listed collides with every category.
+        void initialize(const nlohmann::json& config, World* world);
+
+        // Adds the new collidables to the grid, moves the ones whose transform changed and removes the deleted ones
+        // Only the entities recorded in the world's change feed since the last update are visited.
+        // The feed is filled when the transforms are resolved at the start of a step, so the grid holds the bounds of the
+        // collidables at the end of the previous step. This way, the update only reads the resolved matrices and can run
+        // at the same time as the systems that move entities (it doesn't write anything outside the collision system).
+        void update();
+
+        // Calls "function(Entity*, CollisionComponent&)" for every collidable whose box is touched by the segment from "from" to "to"
+        // on the ground plane (x, z). Passing the positions of a moving object in the last & current steps makes this a swept test,
+        // so a fast object can't pass through a thin box between two steps. Passing the same point twice tests a point.
+        // Only the collidables whose layer is in "mask" are returned (see "getLayerMask").
+        template<typename F>
+        void query(glm::vec2 from, glm::vec2 to, uint32_t mask, F&& function) const {
+            queryCount++;
+            stats.candidates = 0;
+            glm::vec2 min = glm::min(from, to), max = glm::max(from, to);
+            if(mode == CollisionMode::SWEEP_AND_PRUNE){
+                // Move the cursor to the first proxy that starts late enough to reach "min.y"
+                // The player moves a little every step, so the cursor usually moves by a few proxies at most
+                float first = min.y - maxLength;
+                while(cursor > 0 && sorted[cursor - 1].start >= first) cursor--;
+                while(cursor < sorted.size() && sorted[cursor].start < first) cursor++;
+                // Then scan until the proxies start after the end of the query (skipping the holes)
+                for(size_t position = cursor; position < sorted.size(); position++){
+                    const SortedEntry& entry = sorted[position];
+                    if(entry.start > max.y) break;
+                    if(entry.proxy == HOLE) continue;
+                    const Proxy& proxy = proxies[entry.proxy];
+                    if(proxy.max.y >= min.y) test(proxy, from, to, mask, function);
+                }
+                return;
+            }
+            glm::ivec2 minCell = cellOf(min), maxCell = cellOf(max);
+            for(int x = minCell.x; x <= maxCell.x; x++){
+                for(int z = minCell.y; z <= maxCell.y; z++){
+                    auto it = cells.find(cellKey(x, z));
+                    if(it == cells.end()) continue;
+                    for(uint32_t index : it->second) test(proxies[index], from, to, mask, function);
+                }
+            }
+        }
+
+        CollisionMode getMode() const { return mode; }
+        // Returns the layers that the given category collides with (the row of the layer matrix)
+        uint32_t getLayerMask(CollisionCategory category) const { return layerMasks[category]; }
+        const CollisionStats& getStats() const { return stats; }
+
+        // Empties the grid and forgets the world
+        void clear();
+    };
+
+}
@@ -0,0 +1,120 @@
+#include "culling.hpp"
+
+#include <cmath>
+
+// The scalar code must not be fused into multiply-adds, otherwise a box on the edge of a plane could get a different answer
+#if defined(__clang__) || defined(_MSC_VER)
+#   pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#   pragma GCC optimize("fp-contract=off")
+#endif
+
+// We pick the widest instruction set enabled for this compilation (the same choice as "transform-batch.cpp")
+#if defined(__AVX__)
+#   define OUR_CULLING_AVX
+#   include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define OUR_CULLING_SSE2
+#   include <emmintrin.h>
+#endif
+
+namespace our {
+
+    Frustum Frustum::fromMatrix(const glm::mat4& VP) {
+        // glm matrices are indexed by column, so we gather the rows first
+        glm::vec4 rows[4];
+        for(int row = 0; row < 4; row++) rows[row] = glm::vec4(VP[0][row], VP[1][row], VP[2][row], VP[3][row]);
+        // A point is inside the clip volume if -w <= x, y, z <= w which gives two planes per axis
+        Frustum frustum;
+        for(int axis = 0; axis < 3; axis++) {
+            frustum.planes[2 * axis] = rows[3] + rows[axis];
+            frustum.planes[2 * axis + 1] = rows[3] - rows[axis];
+        }
+        return frustum;
+    }
+
+    // The box is outside a plane if its center is farther behind the plane than the projection of its extents on the plane normal
+    // The expression is evaluated in the same order in the kernels below.
+    bool Frustum::intersects(const BoundingBox& box) const {
+        glm::vec3 center = box.getCenter(), extents = box.getExtents();
+        for(const glm::vec4& plane : planes) {
+            float distance = ((plane.x * center.x + plane.y * center.y) + plane.z * center.z) + plane.w;
+            float radius = (std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y) + std::abs(plane.z) * extents.z;
+            if(distance + radius < 0.0f) return false;
+        }
+        return true;
+    }
+
+}
+
+namespace our::kernels {
+
+    static void cullBoxesRange(const Frustum& frustum, const BoxBatch& boxes, size_t begin, uint8_t* visible) {
+        for(size_t index = begin; index < boxes.size(); index++) {
+            glm::vec3 center(boxes.center[0][index], boxes.center[1][index], boxes.center[2][index]);
+            glm::vec3 extents(boxes.extents[0][index], boxes.extents[1][index], boxes.extents[2][index]);
+            uint8_t inside = 1;
+            for(const glm::vec4& plane : frustum.planes) {
+                float distance = ((plane.x * center.x + plane.y * center.y) + plane.z * center.z) + plane.w;
+                float radius = (std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y) + std::abs(plane.z) * extents.z;
+                if(distance + radius < 0.0f) inside = 0;
+            }
+            visible[index] = inside;
+        }
+    }
+
+    void cullBoxesScalar(const Frustum& frustum, const BoxBatch& boxes, uint8_t* visible) {
+        cullBoxesRange(frustum, boxes, 0, visible);
+    }
+
+    void cullBoxes(const Frustum& frustum, const BoxBatch& boxes, uint8_t* visible) {
+        size_t index = 0, count = boxes.size();
+        const float *cx = boxes.center[0].data(), *cy = boxes.center[1].data(), *cz = boxes.center[2].data();
+        const float *ex = boxes.extents[0].data(), *ey = boxes.extents[1].data(), *ez = boxes.extents[2].data();
+#if defined(OUR_CULLING_AVX)
+        for(; index + 8 <= count; index += 8) {
+            __m256 centerX = _mm256_loadu_ps(cx + index), centerY = _mm256_loadu_ps(cy + index), centerZ = _mm256_loadu_ps(cz + index);
+            __m256 extentX = _mm256_loadu_ps(ex + index), extentY = _mm256_loadu_ps(ey + index), extentZ = _mm256_loadu_ps(ez + index);
+            __m256 outside = _mm256_setzero_ps();
+            for(const glm::vec4& plane : frustum.planes) {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(plane.x), centerX),
+                    _mm256_mul_ps(_mm256_set1_ps(plane.y), centerY)),
+                    _mm256_mul_ps(_mm256_set1_ps(plane.z), centerZ)),
+                    _mm256_set1_ps(plane.w));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.x)), extentX),
+                    _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.y)), extentY)),
+                    _mm256_mul_ps(_mm256_set1_ps(std::abs(plane.z)), extentZ));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_LT_OQ));
+            }
+            int mask = _mm256_movemask_ps(outside);
+            for(int lane = 0; lane < 8; lane++) visible[index + lane] = ((mask >> lane) & 1) ? 0 : 1;
+        }
+#endif
+#if defined(OUR_CULLING_AVX) || defined(OUR_CULLING_SSE2)
+        for(; index + 4 <= count; index += 4) {
+            __m128 centerX = _mm_loadu_ps(cx + index), centerY = _mm_loadu_ps(cy + index), centerZ = _mm_loadu_ps(cz + index);
+            __m128 extentX = _mm_loadu_ps(ex + index), extentY = _mm_loadu_ps(ey + index), extentZ = _mm_loadu_ps(ez + index);
+            __m128 outside = _mm_setzero_ps();
+            for(const glm::vec4& plane : frustum.planes) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(plane.x), centerX),
+                    _mm_mul_ps(_mm_set1_ps(plane.y), centerY)),
+                    _mm_mul_ps(_mm_set1_ps(plane.z), centerZ)),
+                    _mm_set1_ps(plane.w));
+                __m128 radius = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(std::abs(plane.x)), extentX),
+                    _mm_mul_ps(_mm_set1_ps(std::abs(plane.y)), extentY)),
+                    _mm_mul_ps(_mm_set1_ps(std::abs(plane.z)), extentZ));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+            int mask = _mm_movemask_ps(outside);
+            for(int lane = 0; lane < 4; lane++) visible[index + lane] = ((mask >> lane) & 1) ? 0 : 1;
+        }
+#endif
+        // The remaining boxes (or all of them if there is no SIMD support) are tested one by one
+        cullBoxesRange(frustum, boxes, index, visible);
+    }
+
+}
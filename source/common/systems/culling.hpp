@@ -0,0 +1,51 @@
+#pragma once
+
+#include "../mesh/bounds.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace our {
+
+    // The 6 planes of a camera frustum (left, right, bottom, top, near & far)
+    // Each plane is stored as (normal, distance) with the normal pointing into the frustum,
+    // so a point p is on the inner side of the plane if dot(normal, p) + distance >= 0.
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        // Extracts the planes from a view projection matrix (Gribb & Hartmann)
+        // The planes are in the space that the matrix transforms from (the world space for "VP").
+        static Frustum fromMatrix(const glm::mat4& VP);
+
+        // Returns false if the box is completely outside one of the planes
+        // A box crossing the corner of the frustum may still be reported as visible, which is fine for culling.
+        bool intersects(const BoundingBox& box) const;
+    };
+
+    // A list of boxes stored as a structure of arrays (one array per coordinate of the centers & extents)
+    // so that the culling kernel can test 4 (SSE) or 8 (AVX) boxes with each instruction.
+    struct BoxBatch {
+        std::vector<float> center[3], extents[3];
+
+        size_t size() const { return center[0].size(); }
+        void clear() {
+            for(int axis = 0; axis < 3; axis++) { center[axis].clear(); extents[axis].clear(); }
+        }
+        void push(const BoundingBox& box) {
+            glm::vec3 boxCenter = box.getCenter(), boxExtents = box.getExtents();
+            for(int axis = 0; axis < 3; axis++) {
+                center[axis].push_back(boxCenter[axis]);
+                extents[axis].push_back(boxExtents[axis]);
+            }
+        }
+    };
+
+    namespace kernels {
+        // Sets visible[i] to 1 if the box i of the batch intersects the frustum and to 0 otherwise
+        // The SIMD version (picked at compile time like the transform kernels) and the scalar version give the same results.
+        void cullBoxes(const Frustum& frustum, const BoxBatch& boxes, uint8_t* visible);
+        void cullBoxesScalar(const Frustum& frustum, const BoxBatch& boxes, uint8_t* visible);
+    }
+
+}
@@ -1,12 +1,77 @@
 #include "forward-renderer.hpp"
 #include "../mesh/mesh-utils.hpp"
 #include "../texture/texture-utils.hpp"
+#include "../deserialize-utils.hpp"
 
 namespace our {
 
+    // The names of the uniforms set in the draw loops (hashed at compile time)
+    namespace uniforms {
+        constexpr UniformName TRANSFORM("transform"), VP("VP"), M("M"), M_IT("M_IT"), EYE("eye");
+        constexpr UniformName LIGHT_DATA("light_data"), LIGHT_GRID("light_grid"), LIGHT_INDICES("light_indices");
+        constexpr UniformName OBJECT_LIGHTS("object_lights"), OBJECT_LIGHT_COUNT("object_light_count");
+    }
+
     void ForwardRenderer::initialize(glm::ivec2 windowSize, const nlohmann::json& config){
         // First, we store the window size for later use
         this->windowSize = windowSize;
+        frustumCulling = config.value("frustumCulling", true);
+
+        // The lights & the sky are sent to the shaders in a uniform buffer filled once per frame
+        // It stays bound to its binding point, so every program that declares the "Lighting" block reads it.
+        glGenBuffers(1, &lightingBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, lightingBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, (GLuint)UniformBlock::LIGHTING, lightingBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        pipelineStates.clear();
+
+        // The lights & the cluster lists are too long for a uniform buffer, so they are read from texture buffers
+        // (one RGBA32F texel per 4 floats of a light, one RG32UI texel per cluster & one R32UI texel per list entry)
+        nlohmann::json clusterConfig = config.value("lightClusters", nlohmann::json::object());
+        if(clusterConfig.value("enabled", false))
+            lightClusters.configure(clusterConfig.value("size", glm::uvec3(16, 9, 24)), clusterConfig.value("threshold", 1.0f / 256.0f));
+        else
+            // Without the clusters, there is a single cluster & no light is ignored, so every fragment loops over all the lights
+            lightClusters.configure(glm::uvec3(1), 0.0f);
+        GLint maxTexels = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+        lightClusters.setMaxIndices((size_t)maxTexels);
+        objectLightLists = config.value("lightLists", "clusters") == "objects";
+        objectLightCap = glm::min(config.value("objectLightCap", 8u), MAX_OBJECT_LIGHTS);
+
+        // The depth programs are always created so that the pre-pass can be turned on while running
+        depthPrepass = config.value("depthPrepass", false);
+        depthShader = new ShaderProgram();
+        depthShader->attach("assets/shaders/depth.vert", GL_VERTEX_SHADER);
+        depthShader->attach("assets/shaders/depth.frag", GL_FRAGMENT_SHADER);
+        depthShader->link();
+        depthLitShader = new ShaderProgram();
+        depthLitShader->attach("assets/shaders/depth-lit.vert", GL_VERTEX_SHADER);
+        depthLitShader->attach("assets/shaders/depth.frag", GL_FRAGMENT_SHADER);
+        depthLitShader->link();
+        depthInstancedShader = new ShaderProgram();
+        depthInstancedShader->attach("assets/shaders/depth-instanced.vert", GL_VERTEX_SHADER);
+        depthInstancedShader->attach("assets/shaders/depth.frag", GL_FRAGMENT_SHADER);
+        depthInstancedShader->link();
+
+        // The commands sharing a mesh & a material are drawn with one instanced draw ("instancing" & "minInstances" in the config)
+        instancing = config.value("instancing", false);
+        minInstances = config.value("minInstances", 2u);
+        glGenBuffers(1, &instanceBuffer);
+        glGenQueries(2, fragmentQueries);
+        setFragmentCounting(config.value("countFragments", false));
+        const GLenum lightFormats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+        glGenBuffers(3, lightBuffers);
+        glGenTextures(3, lightTextures);
+        for(int index = 0; index < 3; index++){
+            glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[index]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_DYNAMIC_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTextures[index]);
+            glTexBuffer(GL_TEXTURE_BUFFER, lightFormats[index], lightBuffers[index]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
         // Then we check if there is a sky texture in the configuration
         if(config.contains("sky")){
@@ -169,6 +234,18 @@ Parameters
     }
 
     void ForwardRenderer::destroy(){
+        glDeleteBuffers(1, &lightingBuffer);
+        lightingBuffer = 0;
+        glDeleteTextures(3, lightTextures);
+        glDeleteBuffers(3, lightBuffers);
+        for(int index = 0; index < 3; index++) lightTextures[index] = lightBuffers[index] = 0;
+        delete depthShader;
+        delete depthLitShader;
+        delete depthInstancedShader;
+        depthShader = depthLitShader = depthInstancedShader = nullptr;
+        glDeleteBuffers(1, &instanceBuffer);
+        instanceBuffer = 0;
+        glDeleteQueries(2, fragmentQueries);
         // Delete all objects related to the sky
         if(skyMaterial){
             delete skySphere;
@@ -189,37 +266,219 @@ Parameters
         }
     }
 
+    size_t ForwardRenderer::cull(std::vector<RenderCommand>& commands, const Frustum& frustum){
+        // The bounds are copied into a structure of arrays so that the kernel can test many boxes at once
+        cullingBoxes.clear();
+        for(const RenderCommand& command : commands) cullingBoxes.push(command.bounds);
+        cullingVisibility.resize(commands.size());
+        kernels::cullBoxes(frustum, cullingBoxes, cullingVisibility.data());
+        size_t kept = 0;
+        for(size_t index = 0; index < commands.size(); index++)
+            if(cullingVisibility[index]) commands[kept++] = commands[index];
+        size_t culled = commands.size() - kept;
+        commands.resize(kept);
+        return culled;
+    }
+
+    uint32_t ForwardRenderer::getPipelineId(const PipelineState& state){
+        // There are only a few distinct states (most materials use the same options), so a linear search is enough
+        for(uint32_t id = 0; id < (uint32_t)pipelineStates.size(); id++)
+            if(pipelineStates[id] == state) return id;
+        pipelineStates.push_back(state);
+        return (uint32_t)pipelineStates.size() - 1;
+    }
+
+    void ForwardRenderer::uploadLighting(const glm::mat4& V, const glm::mat4& P, const CameraComponent* camera){
+        // Each light's position & direction are computed once per frame here instead of once per lit draw
+        lightClusters.clear();
+        for(LightComponent* light : lightSources){
+            if(light->type < 0) continue;
+            const glm::mat4& matrix = light->getOwner()->getRenderMatrix();
+            ClusterLight data{};
+            data.type = (float)light->type;
+            data.position = glm::vec3(matrix * glm::vec4(0, 0, 0, 1));
+            data.direction = glm::vec3(matrix * glm::vec4(0, -1, 0, 0));
+            data.diffuse = light->diffuse;
+            data.specular = light->specular;
+            data.attenuation = light->attenuation;
+            data.innerAngle = light->coneAngles.x;
+            data.outerAngle = light->coneAngles.y;
+            lightClusters.add(data);
+        }
+        lightClusters.build(V, P, camera->near, camera->far);
+        stats.lights = lightClusters.getStats();
+
+        lighting.view = V;
+        // set sky lights to values
+        lighting.skyTop = glm::vec3(0.01f, 0.01f, 0.01f);
+        lighting.skyMiddle = glm::vec3(0.01f, 0.01f, 0.01f);
+        lighting.skyBottom = glm::vec3(0.01f, 0.01f, 0.01f);
+        lighting.clusterCount = lightClusters.getGridSize();
+        lighting.directionalCount = lightClusters.getDirectionalCount();
+        lighting.clustersPerPixel = glm::vec2(lighting.clusterCount.x, lighting.clusterCount.y) / glm::vec2(windowSize);
+        lighting.clusterNear = lightClusters.getNear();
+        lighting.slicesPerLog = lightClusters.getSlicesPerLog();
+
+        // Respecifying the whole buffers lets the driver give us new memory instead of waiting for the draws of the last frame
+        glBindBuffer(GL_UNIFORM_BUFFER, lightingBuffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(LightingBlock), &lighting, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        const void* contents[3] = { lightClusters.getLights().data(), lightClusters.getGrid().data(), lightClusters.getIndices().data() };
+        size_t sizes[3] = {
+            lightClusters.getLights().size() * sizeof(ClusterLight),
+            lightClusters.getGrid().size() * sizeof(uint32_t),
+            lightClusters.getIndices().size() * sizeof(uint32_t)
+        };
+        for(int index = 0; index < 3; index++){
+            glBindBuffer(GL_TEXTURE_BUFFER, lightBuffers[index]);
+            // An empty buffer can't be read, so we keep at least one texel
+            glBufferData(GL_TEXTURE_BUFFER, sizes[index] > 0 ? sizes[index] : 16, sizes[index] > 0 ? contents[index] : nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+        // The light textures stay bound to their units for the whole frame (the materials only bind 2D textures to the units before them)
+        const GLint units[3] = { light_units::LIGHTS, light_units::GRID, light_units::INDICES };
+        for(int index = 0; index < 3; index++){
+            GLState::get().activeTexture(GL_TEXTURE0 + units[index]);
+            glBindTexture(GL_TEXTURE_BUFFER, lightTextures[index]);
+        }
+        GLState::get().activeTexture(GL_TEXTURE0);
+    }
+
+    void ForwardRenderer::setFragmentCounting(bool enabled){
+        countFragments = enabled;
+        // The results of the queries issued before the counting was turned off are not read
+        fragmentQueryPending[0] = fragmentQueryPending[1] = false;
+        shadedFragments = 0;
+    }
+
+    void ForwardRenderer::buildBatches(){
+        opaqueBatches.clear();
+        instanceData.clear();
+        for (uint32_t first = 0; first < (uint32_t)opaqueQueue.size();)
+        {
+            const RenderCommand& command = opaqueCommands[opaqueQueue[first].command];
+            // The sort keys put the commands sharing a material & a mesh next to each other, so each run can be one batch
+            uint32_t end = first + 1;
+            if (instancing && command.material->shader->getInstanced())
+            {
+                while (end < (uint32_t)opaqueQueue.size())
+                {
+                    const RenderCommand& next = opaqueCommands[opaqueQueue[end].command];
+                    if (next.material != command.material || next.mesh != command.mesh) break;
+                    end++;
+                }
+            }
+            uint32_t count = end - first;
+            if (count >= minInstances && count > 1)
+            {
+                DrawBatch batch{ first, count, true, instanceData.size() * sizeof(InstanceData) };
+                for (uint32_t index = first; index < end; index++)
+                {
+                    const glm::mat4& M = opaqueCommands[opaqueQueue[index].command].localToWorld;
+                    instanceData.push_back({ M, glm::transpose(glm::inverse(M)) });
+                }
+                opaqueBatches.push_back(batch);
+                stats.instancedBatches++;
+                stats.instancedCommands += count;
+            }
+            else
+            {
+                for (uint32_t index = first; index < end; index++) opaqueBatches.push_back({ index, 1, false, 0 });
+            }
+            first = end;
+        }
+        // All the instances of the frame are sent at once (a new buffer each frame, so we never wait for the last frame's draws)
+        if (!instanceData.empty())
+        {
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glBufferData(GL_ARRAY_BUFFER, instanceData.size() * sizeof(InstanceData), instanceData.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+
+    void ForwardRenderer::drawDepthPrepass(const glm::mat4& VP){
+        // The pipeline state of each material is still applied since its face culling decides which faces write the depth
+        GLState& state = GLState::get();
+        ShaderProgram* lastShader = nullptr;
+        GLuint lastVertexArray = 0;
+        uint32_t lastPipeline = ~0u;
+        for (const DrawBatch& batch : opaqueBatches)
+        {
+            const RenderCommand& command = opaqueCommands[opaqueQueue[batch.first].command];
+            const PipelineState& pipeline = command.material->pipelineState;
+            if (!usesDepthPrepass(pipeline)) continue;
+            if (command.pipeline != lastPipeline)
+            {
+                pipeline.setup();
+                state.colorMask(glm::bvec4(false));
+                lastPipeline = command.pipeline;
+            }
+            // The lit objects compute their position like "lighted.vert", the others like "tinted.vert" & "textured.vert"
+            // and the instanced batches like the instanced variants
+            bool lit = command.kind == MaterialKind::LIT;
+            ShaderProgram* shader = batch.instanced ? depthInstancedShader : (lit ? depthLitShader : depthShader);
+            if (shader != lastShader)
+            {
+                shader->use();
+                if (shader != depthShader) shader->set(uniforms::VP, VP);
+                lastShader = shader;
+            }
+            if (command.mesh->getVertexArray(batch.instanced) != lastVertexArray)
+            {
+                command.mesh->bind(batch.instanced);
+                lastVertexArray = command.mesh->getVertexArray(batch.instanced);
+            }
+            if (batch.instanced)
+            {
+                command.mesh->setInstanceData(instanceBuffer, batch.instanceOffset);
+                command.mesh->drawInstancedBound((GLsizei)batch.count);
+            }
+            else
+            {
+                if (lit) shader->set(uniforms::M, command.localToWorld);
+                else shader->set(uniforms::TRANSFORM, VP * command.localToWorld);
+                command.mesh->drawBound();
+            }
+            stats.prepassDraws++;
+        }
+    }
+
     void ForwardRenderer::render(World* world){
         // First of all, we search for a camera and for all the mesh renderers
         CameraComponent* camera = nullptr;
         opaqueCommands.clear();
         transparentCommands.clear();
         lightSources.clear();
-        for(auto entity : world->getEntities()){
-            // If we hadn't found a camera yet, we look for a camera in this entity
-            if(!camera) camera = entity->getComponent<CameraComponent>();
-            // If this entity has a mesh renderer component
-            if(auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer){
-                // We construct a command from it
-                RenderCommand command;
-                command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-                command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-                command.mesh = meshRenderer->mesh;
-                command.material = meshRenderer->material;
-                // if it is transparent, we add it to the transparent commands list
-                if(command.material->transparent){
-                    transparentCommands.push_back(command);
-                } else {
-                // Otherwise, we add it to the opaque command list
-                    opaqueCommands.push_back(command);
-                }
-            }
-            // if light component store it
-            if (auto lightComp = entity->getComponent<LightComponent>(); lightComp)
-            {
-                lightSources.push_back(lightComp);
+        stats = RenderStats();
+        // We look for the first camera in the world
+        world->view<CameraComponent>().each([&camera](Entity*, CameraComponent& component){
+            if(!camera) camera = &component;
+        });
+        // For each entity that has a mesh renderer component
+        world->view<MeshRendererComponent>().each([this](Entity* entity, MeshRendererComponent& meshRenderer){
+            // We construct a command from it
+            RenderCommand command;
+            command.localToWorld = entity->getRenderMatrix();
+            command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
+            command.mesh = meshRenderer.mesh;
+            command.material = meshRenderer.material;
+            command.kind = command.material->getKind();
+            command.bounds = command.mesh->getBounds().box.transform(command.localToWorld);
+            // if it is transparent, we add it to the transparent commands list
+            if(command.material->transparent){
+                transparentCommands.push_back(command);
+            } else {
+            // Otherwise, we add it to the opaque command list
+                opaqueCommands.push_back(command);
             }
-        }
+        });
+        // We store every light component
+        world->view<LightComponent>().each([this](Entity*, LightComponent& light){
+            lightSources.push_back(&light);
+        });
+
+        stats.commands = opaqueCommands.size() + transparentCommands.size();
 
         // If there is no camera, we return (we cannot render without a camera)
         if(camera == nullptr) return;
@@ -227,7 +486,7 @@ Parameters
         //TODO: (Req 9) Modify the following line such that "cameraForward" contains a vector pointing the camera forward direction
         // HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
         auto owner = camera->getOwner();
-        auto M = owner->getLocalToWorldMatrix();
+        auto M = owner->getRenderMatrix();
         glm::vec3 eye = M * glm::vec4(0, 0, 0, 1);
         glm::vec3 center = M * glm::vec4(0, 0, -1, 1);
         // as we get a vector direction from two points by subtract them
@@ -235,6 +494,33 @@ Parameters
         // also notice that "w" of the vector has to be 0 , which is already done in the subtraction
         glm::vec3 cameraForward = glm::normalize(center - eye);
 
+        //TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
+        //we use the define functions in "camera", sending the windowSize to calculate the aspect ratio 
+        glm::mat4 P = camera->getProjectionMatrix(windowSize);
+        glm::mat4 V = camera->getViewMatrix();
+        glm::mat4 VP =  P*V ;
+
+        // The commands outside the camera frustum are removed before sorting, so the sort and the draw loops only see the visible ones
+        if(frustumCulling){
+            Frustum frustum = Frustum::fromMatrix(VP);
+            stats.culled = cull(opaqueCommands, frustum) + cull(transparentCommands, frustum);
+        }
+        stats.drawn = opaqueCommands.size() + transparentCommands.size();
+
+        // Each opaque command gets a key from its shader, pipeline state, material, mesh & distance to the camera
+        // then the keys are sorted so that the draws sharing state are next to each other (front to back inside each group)
+        opaqueQueue.clear();
+        for(uint32_t index = 0; index < (uint32_t)opaqueCommands.size(); index++){
+            RenderCommand& command = opaqueCommands[index];
+            command.pipeline = getPipelineId(command.material->pipelineState);
+            float depth = glm::dot(command.center - eye, cameraForward) / camera->far;
+            uint64_t key = sort_key::make(command.material->shader->getOpenGLName(), command.pipeline,
+                command.material->getId(), command.mesh->getId(), depth);
+            opaqueQueue.push_back({ key, index });
+        }
+        radixSort(opaqueQueue, sortScratch);
+        buildBatches();
+
         std::sort(transparentCommands.begin(), transparentCommands.end(), [cameraForward](const RenderCommand& first, const RenderCommand& second){
             //TODO: (Req 9) Finish this function
             // HINT: the following return should return true "first" should be drawn before "second". 
@@ -248,11 +534,7 @@ Parameters
             return (glm::dot(cameraForward,first.center) > glm::dot(cameraForward,second.center)  );
         });
 
-        //TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
-        //we use the define functions in "camera", sending the windowSize to calculate the aspect ratio 
-        glm::mat4 P = camera->getProjectionMatrix(windowSize);
-        glm::mat4 V = camera->getViewMatrix();
-        glm::mat4 VP =  P*V ;
+        uploadLighting(V, P, camera);
 
         //TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
         //Specify the lower left corner of the viewport rectangle, in pixels , we set it to be (0,0)
@@ -265,8 +547,8 @@ Parameters
         glClearDepth(1.0);
 
         //TODO: (Req 9) Set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
-        glColorMask(true, true, true, true);
-        glDepthMask(true); 
+        GLState::get().colorMask(glm::bvec4(true));
+        GLState::get().depthMask(true);
 
         // If there is a postprocess material, bind the framebuffer
         if(postprocessMaterial){
@@ -278,75 +560,153 @@ Parameters
         //TODO: (Req 9) Clear the color and depth buffers
         // by this we clear both color and depth 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (depthPrepass) drawDepthPrepass(VP);
+
+        // The fragments of the opaque pass are counted with an occlusion query (the samples that pass the depth test)
+        if (countFragments)
+        {
+            // The query issued last frame is read only if its result is ready, otherwise we keep the older count
+            int previous = 1 - fragmentQuery;
+            if (fragmentQueryPending[previous])
+            {
+                GLint available = 0;
+                glGetQueryObjectiv(fragmentQueries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (available)
+                {
+                    GLuint64 samples = 0;
+                    glGetQueryObjectui64v(fragmentQueries[previous], GL_QUERY_RESULT, &samples);
+                    shadedFragments = samples;
+                    fragmentQueryPending[previous] = false;
+                }
+            }
+            glBeginQuery(GL_SAMPLES_PASSED, fragmentQueries[fragmentQuery]);
+        }
         
         //TODO: (Req 9) Draw all the opaque commands
         // Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-        
-        
-
-         for (auto command : opaqueCommands)
+        // The opaque commands are drawn in the order of their sort keys, so consecutive commands usually share their shader,
+        // pipeline state, material & mesh. Only the state that differs from the previous command is applied.
+        // The runs of commands sharing a mesh & a material were grouped into instanced batches (see "buildBatches").
+        ShaderProgram* lastShader = nullptr;
+        const Material* lastMaterial = nullptr;
+        GLuint lastVertexArray = 0;
+        uint32_t lastPipeline = ~0u;
+        for (const DrawBatch& batch : opaqueBatches)
         {
-             command.material->setup();
+            const RenderCommand& command = opaqueCommands[opaqueQueue[batch.first].command];
+            // The instanced batches use the instanced variant of the material's shader
+            ShaderProgram* shader = batch.instanced ? command.material->shader->getInstanced() : command.material->shader;
+            bool shaderChanged = false;
+            if (command.material != lastMaterial || shader != lastShader)
+            {
+                if (command.pipeline != lastPipeline)
+                {
+                    command.material->pipelineState.setup();
+                    lastPipeline = command.pipeline;
+                    stats.pipelineBinds++;
+                }
+                if (shader != lastShader)
+                {
+                    shader->use();
+                    lastShader = shader;
+                    shaderChanged = true;
+                    stats.shaderBinds++;
+                }
+                command.material->setupParameters(shader);
+                lastMaterial = command.material;
+                stats.materialBinds++;
+            }
             // if the material of the object is lighted
-            if (auto light_material = dynamic_cast<LitMaterial *>(command.material); light_material)
+            if (command.kind == MaterialKind::LIT)
             {
-                // set sky lights to values
-            glm::vec3 sky_top = glm::vec3(0.01f, 0.01f, 0.01f);
-            glm::vec3 sky_middle = glm::vec3(0.01f, 0.01f, 0.01f);
-            glm::vec3 sky_bottom = glm::vec3(0.01f, 0.01f, 0.01f);
-                // set VP to VP matrix
-                light_material->shader->set("VP", VP);
-                // set M to command.localToWorld
-                light_material->shader->set("M", command.localToWorld);
-                // set eye to eye
-                light_material->shader->set("eye", eye);
-                // set M_IT to inverse(command.localToWorld)
-                light_material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
-                // set light_count to size of lightSources
-                light_material->shader->set("light_count", (int)lightSources.size());
-                
-                // send sky lights to shader
-            light_material->shader->set("sky.top", sky_top);
-            light_material->shader->set("sky.middle", sky_middle);
-            light_material->shader->set("sky.bottom", sky_bottom);
-                
-                // for loop for all light sources
-                for (int i = 0; i < (int)lightSources.size(); i++)
+                // The uniforms shared by all the objects are sent once each time the shader changes
+                // (the program keeps them while the next commands use the same shader)
+                // The lights & the sky are not sent here since the shader reads them from the lighting & light buffers.
+                if (shaderChanged)
+                {
+                    // set VP to VP matrix
+                    shader->set(uniforms::VP, VP);
+                    // set eye to eye
+                    shader->set(uniforms::EYE, eye);
+                    // the light buffers are bound to fixed texture units (see "uploadLighting")
+                    shader->set(uniforms::LIGHT_DATA, light_units::LIGHTS);
+                    shader->set(uniforms::LIGHT_GRID, light_units::GRID);
+                    shader->set(uniforms::LIGHT_INDICES, light_units::INDICES);
+                    // a negative count tells the shader to read the cluster lists
+                    // (the instances of a batch share their uniforms, so they always use the cluster lists)
+                    if (!objectLightLists || batch.instanced) shader->set(uniforms::OBJECT_LIGHT_COUNT, (GLint)-1);
+                }
+                if (!batch.instanced)
+                {
+                    // set M to command.localToWorld
+                    shader->set(uniforms::M, command.localToWorld);
+                    // set M_IT to inverse(command.localToWorld)
+                    shader->set(uniforms::M_IT, glm::transpose(glm::inverse(command.localToWorld)));
+                }
+                // send the most relevant point & spot lights that reach the object (the directional lights are always used)
+                if (objectLightLists && !batch.instanced)
                 {
-                    if(lightSources[i]->type >=0){
-
-                    // calculate position and direction of the light source based on the object
-                    glm::vec3 position = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,0,0,1);
-                    glm::vec3 direction = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,-1,0,0);
-                    
-                    // set light material
-                    // set direction
-                    light_material->shader->set("lights[" + std::to_string(i) + "].direction",direction);
-                    // set color
-                    light_material->shader->set("lights[" + std::to_string(i) + "].color",lightSources[i]->color);
-                    // set type
-                    light_material->shader->set("lights[" + std::to_string(i) + "].type", lightSources[i]->type);
-                    // set position
-                    light_material->shader->set("lights[" + std::to_string(i) + "].position", position); 
-                    // set diffuse
-                    light_material->shader->set("lights[" + std::to_string(i) + "].diffuse", lightSources[i]->diffuse);
-                    // set specular
-                    light_material->shader->set("lights[" + std::to_string(i) + "].specular", lightSources[i]->specular);
-                    // set attenuation
-                    light_material->shader->set("lights[" + std::to_string(i) + "].attenuation", lightSources[i]->attenuation);
-                    // set cone angles
-                    light_material->shader->set("lights[" + std::to_string(i) + "].coneAngles", lightSources[i]->coneAngles);
-                    
-                }}
+                    size_t reaching = lightClusters.selectLights(command.bounds, objectLightCap, objectLights);
+                    GLint indices[MAX_OBJECT_LIGHTS];
+                    for (size_t index = 0; index < objectLights.size(); index++) indices[index] = (GLint)objectLights[index];
+                    shader->set(uniforms::OBJECT_LIGHT_COUNT, (GLint)objectLights.size());
+                    if (!objectLights.empty()) shader->set(uniforms::OBJECT_LIGHTS, indices, (GLsizei)objectLights.size());
+                    stats.objectLights += objectLights.size();
+                    stats.objectLightsDropped += reaching - objectLights.size();
+                }
+            }
+            // the instanced variants read the model matrices from the instance buffer and only need VP
+            else if (batch.instanced)
+            {
+                if (shaderChanged) shader->set(uniforms::VP, VP);
             }
-            
             // if the material of the isn't lighted
             else
                 //set the "transform" uniform to be equal the model-view-projection matrix
-                command.material->shader->set("transform", VP * command.localToWorld);
-                        
-            command.mesh->draw();
+                shader->set(uniforms::TRANSFORM, VP * command.localToWorld);
+
+            // The commands that are already in the depth buffer only shade the fragments matching the stored depth
+            // (the depth programs compute the same positions, so GL_LEQUAL passes exactly where the depth is equal)
+            if (depthPrepass)
+            {
+                const PipelineState& pipeline = command.material->pipelineState;
+                if (usesDepthPrepass(pipeline))
+                {
+                    GLState::get().depthFunc(GL_LEQUAL);
+                    GLState::get().depthMask(false);
+                }
+                else
+                {
+                    GLState::get().depthFunc(pipeline.depthTesting.function);
+                    GLState::get().depthMask(pipeline.depthMask);
+                }
+            }
+
+            // All the meshes share the vertex arrays of the geometry arena (one for the regular draws & one for the instanced draws),
+            // so they are only bound when the pass switches between regular & instanced draws
+            if (command.mesh->getVertexArray(batch.instanced) != lastVertexArray)
+            {
+                command.mesh->bind(batch.instanced);
+                lastVertexArray = command.mesh->getVertexArray(batch.instanced);
+                stats.vertexArrayBinds++;
+            }
+            if (batch.instanced)
+            {
+                command.mesh->setInstanceData(instanceBuffer, batch.instanceOffset);
+                command.mesh->drawInstancedBound((GLsizei)batch.count);
+            }
+            else command.mesh->drawBound();
+            stats.drawCalls++;
+        }
+
+        if (countFragments)
+        {
+            glEndQuery(GL_SAMPLES_PASSED);
+            fragmentQueryPending[fragmentQuery] = true;
+            fragmentQuery = 1 - fragmentQuery;
         }
+        stats.shadedFragments = shadedFragments;
 
 
         // If there is a sky material, draw the sky
@@ -381,7 +741,7 @@ Parameters
             //TODO: (Req 10) set the "transform" uniform
             //we use alwaysBehindTransform above to ensure that the sky is behind everything  (have the largest normalized depth)
             //we multiply it at the last stage after multiplying it with V & P & M
-            skyMaterial->shader->set("transform", alwaysBehindTransform * VP * skyModel);
+            skyMaterial->shader->set(uniforms::TRANSFORM, alwaysBehindTransform * VP * skyModel);
 
             //TODO: (Req 10) draw the sky sphere
             skySphere->draw();
@@ -392,7 +752,7 @@ Parameters
         {
             command.material->setup();
             //same concept as opaqueCommands loop
-            command.material->shader->set("transform", VP * command.localToWorld);
+            command.material->shader->set(uniforms::TRANSFORM, VP * command.localToWorld);
             command.mesh->draw();
         }
 
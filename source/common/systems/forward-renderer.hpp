@@ -5,6 +5,9 @@
 #include "../components/mesh-renderer.hpp"
 #include "../asset-loader.hpp"
 #include "../components/light.hpp"
+#include "culling.hpp"
+#include "render-queue.hpp"
+#include "light-clusters.hpp"
 #include <glad/gl.h>
 #include <vector>
 #include <algorithm>
@@ -18,8 +21,54 @@ namespace our
     struct RenderCommand {
         glm::mat4 localToWorld;
         glm::vec3 center;
+        BoundingBox bounds; // The box containing the mesh in the world space (used for culling)
         Mesh* mesh;
         Material* material;
+        MaterialKind kind;  // The kind of the material (found once when the command is built)
+        uint32_t pipeline;  // The ID of the material's pipeline state (see "ForwardRenderer::getPipelineId")
+    };
+
+    // The contents of the "Lighting" uniform block of "lighted.frag" laid out with the std140 rules
+    // (every vec3 starts at a multiple of 16 bytes). The lights themselves are in texture buffers (see "LightClusters").
+    struct LightingBlock {
+        glm::mat4 view;                 // Used by the shader to find the depth of a fragment
+        glm::vec3 skyTop;    float padding0;
+        glm::vec3 skyMiddle; float padding1;
+        glm::vec3 skyBottom; float padding2;
+        glm::uvec3 clusterCount; uint32_t directionalCount;
+        glm::vec2 clustersPerPixel; float clusterNear; float slicesPerLog;
+    };
+    static_assert(sizeof(LightingBlock) == 144, "The lighting block must match its std140 size");
+
+    // The texture units of the light buffers read by "lighted.frag" (the materials use the units before them)
+    namespace light_units {
+        constexpr GLint LIGHTS = 5, GRID = 6, INDICES = 7;
+    }
+
+    // A draw of the opaque pass: one command, or a run of commands sharing a mesh & a material drawn as instances
+    struct DrawBatch {
+        uint32_t first;        // The position of the first command in the opaque queue
+        uint32_t count;        // The number of consecutive commands of the queue in the batch
+        bool instanced;
+        size_t instanceOffset; // The offset (in bytes) of the batch's instances in the instance buffer
+    };
+
+    // The counters of the last rendered frame (shown in the stats window)
+    struct RenderStats {
+        size_t commands = 0; // The number of mesh renderers found in the world
+        size_t culled = 0;   // The number of commands skipped because their bounds are outside the camera frustum
+        size_t drawn = 0;    // The number of commands drawn
+        // The number of times the opaque draws changed each kind of state (the rest of the draws reused the previous state)
+        // The meshes share the vertex array of the geometry arena, so switching between them doesn't need a bind
+        size_t shaderBinds = 0, pipelineBinds = 0, materialBinds = 0, vertexArrayBinds = 0;
+        size_t drawCalls = 0;         // The draw calls of the opaque pass
+        size_t instancedBatches = 0;  // The instanced draws and the commands they drew
+        size_t instancedCommands = 0;
+        ClusterStats lights; // The lights sent to the shaders and their assignment to the clusters
+        // The lights listed for the lit draws and the ones left out by the cap (only counted when the draws get their own lists)
+        size_t objectLights = 0, objectLightsDropped = 0;
+        size_t prepassDraws = 0;      // The opaque commands drawn in the depth pre-pass
+        uint64_t shadedFragments = 0; // The fragments that passed the depth test in the opaque pass (a frame or two old, see "setFragmentCounting")
     };
 
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
@@ -33,6 +82,16 @@ namespace our
         // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
+        // If true, the commands outside the camera frustum are removed before drawing (the "frustumCulling" option in the config)
+        bool frustumCulling = true;
+        // The bounds of the commands being culled and the result of the culling kernel (kept to prevent reallocating them every frame)
+        BoxBatch cullingBoxes;
+        std::vector<uint8_t> cullingVisibility;
+        RenderStats stats;
+        // The sort keys of the opaque commands (and the second buffer of the radix sort)
+        std::vector<SortItem> opaqueQueue, sortScratch;
+        // The distinct pipeline states seen by the renderer. The ID of a state is its index in this list.
+        std::vector<PipelineState> pipelineStates;
         // Objects used for rendering a skybox
         Mesh* skySphere;
         TexturedMaterial* skyMaterial;
@@ -43,7 +102,51 @@ namespace our
 
         // Objects to support lighting
         std::vector<LightComponent*> lightSources;
+        // The uniform buffer holding the sky & the cluster grid settings (bound to UniformBlock::LIGHTING) and its contents
+        GLuint lightingBuffer = 0;
+        LightingBlock lighting;
+        // The lights are assigned to the clusters of the camera frustum every frame (the "lightClusters" options in the config)
+        // If the clusters are not enabled, the grid has one cluster that holds all the lights.
+        LightClusters lightClusters;
+        // The buffers holding the lights, the offset & size of each cluster's list and the lists, and the buffer textures reading them
+        GLuint lightBuffers[3] = {}, lightTextures[3] = {};
+        // If true, each lit draw gets a list of the lights reaching its bounds instead of using the cluster lists ("lightLists": "objects")
+        // Only the "objectLightCap" brightest lights at the object are kept.
+        static constexpr uint32_t MAX_OBJECT_LIGHTS = 16; // The size of "object_lights" in "lighted.frag"
+        bool objectLightLists = false;
+        uint32_t objectLightCap = 8;
+        std::vector<uint32_t> objectLights;
+        // If true, the opaque commands are first drawn with a depth only program and the color writes off ("depthPrepass" in the config)
+        // then the main pass only shades the fragments that are equal to the stored depth, so each pixel is shaded once.
+        bool depthPrepass = false;
+        ShaderProgram *depthShader = nullptr, *depthLitShader = nullptr, *depthInstancedShader = nullptr;
+        // If true, the runs of opaque commands sharing a mesh & a material (at least "minInstances") are drawn as instances
+        // of the instanced variant of the shader. The matrices of all the instances are streamed to "instanceBuffer" every frame.
+        bool instancing = false;
+        uint32_t minInstances = 2;
+        GLuint instanceBuffer = 0;
+        std::vector<InstanceData> instanceData;
+        std::vector<DrawBatch> opaqueBatches;
+        // The occlusion queries counting the fragments of the opaque pass (two so that we can read last frame's result without waiting)
+        bool countFragments = false;
+        GLuint fragmentQueries[2] = {};
+        bool fragmentQueryPending[2] = {};
+        int fragmentQuery = 0;
+        uint64_t shadedFragments = 0;
         LitMaterial* lightMaterial;
+
+        // Removes the commands whose bounds are outside the frustum (keeping the order of the rest) and returns how many were removed
+        size_t cull(std::vector<RenderCommand>& commands, const Frustum& frustum);
+        // Returns the ID of the given pipeline state. Equal states get the same ID.
+        uint32_t getPipelineId(const PipelineState& state);
+        // Assigns the lights to the clusters, then sends them with the sky to the lighting buffer & the light buffers
+        void uploadLighting(const glm::mat4& V, const glm::mat4& P, const CameraComponent* camera);
+        // Returns true if the commands using this pipeline state are drawn in the depth pre-pass (they must test & write the depth)
+        static bool usesDepthPrepass(const PipelineState& pipeline) { return pipeline.depthTesting.enabled && pipeline.depthMask; }
+        // Splits the sorted opaque queue into batches and uploads the instance data
+        void buildBatches();
+        // Draws the depth of the opaque commands (in the order of the opaque queue)
+        void drawDepthPrepass(const glm::mat4& VP);
     public:
         // Initialize the renderer including the sky and the Postprocessing objects.
         // windowSize is the width & height of the window (in pixels).
@@ -52,6 +155,15 @@ namespace our
         void destroy();
         // This function should be called every frame to draw the given world
         void render(World* world);
+
+        const RenderStats& getStats() const { return stats; }
+
+        // These can be changed while running to compare the shaded fragments with & without the pre-pass
+        void setDepthPrepass(bool enabled) { depthPrepass = enabled; }
+        bool getDepthPrepass() const { return depthPrepass; }
+        // The fragment count is read from a query issued one or two frames earlier, since waiting for the current one would stall the CPU
+        void setFragmentCounting(bool enabled);
+        bool getFragmentCounting() const { return countFragments; }
        
 
 
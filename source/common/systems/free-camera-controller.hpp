@@ -5,6 +5,7 @@
 #include "../components/free-camera-controller.hpp"
 #include "../components/running-object.hpp"
 #include "../components/collision.hpp"
+#include "collision.hpp"
 
 #include "../application.hpp"
 
@@ -28,15 +29,46 @@ namespace our
     // For more information, see "common/components/free-camera-controller.hpp"
     class FreeCameraControllerSystem {
         Application* app; // The application in which the state runs
+        const CollisionSystem* collisions; // The grid used to find the collidables near the player
         bool mouse_locked = false; // Is the mouse locked
+        // The input sampled at the start of the frame (see "sampleInput"), used by every step of the frame
+        int right_keys = 0; // The number of pressed keys that move the player right (D & RIGHT)
+        int left_keys = 0;  // The number of pressed keys that move the player left (A & LEFT)
+        glm::vec2 last_player_position; // The position of the player (on x & z) when the collisions were last checked
+        bool has_last_player_position = false;
+        CollisionCategory player_category = 0;  // The category used to find what the player collides with in the layer matrix
+        CollisionCategory penalty_category = 0; // Hitting a collidable of this category is a penalty (any other category is a reward)
 
     public:
         // When a state enters, it should call this function and give it the pointer to the application
-        void enter(Application* app){
+        // and the collision system that tracks the collidables of the world
+        void enter(Application* app, const CollisionSystem* collisions){
             this->app = app;
+            this->collisions = collisions;
+            has_last_player_position = false;
+            right_keys = left_keys = 0;
+            player_category = internCollisionCategory("player");
+            penalty_category = internCollisionCategory("penalty");
         }
 
-        // This should be called every frame to update all entities containing a FreeCameraControllerComponent 
+        // This should be called once per frame (before the simulation steps) to read the mouse & keyboard.
+        // The steps run at a different rate than the frames, so reading the input in "update" would read it zero or many times per frame.
+        void sampleInput() {
+            // If the left mouse button is pressed, we lock and hide the mouse. This common in First Person Games.
+            if(app->getMouse().isPressed(GLFW_MOUSE_BUTTON_1) && !mouse_locked){
+                app->getMouse().lockMouse(app->getWindow());
+                mouse_locked = true;
+            // If the left mouse button is released, we unlock and unhide the mouse.
+            } else if(!app->getMouse().isPressed(GLFW_MOUSE_BUTTON_1) && mouse_locked) {
+                app->getMouse().unlockMouse(app->getWindow());
+                mouse_locked = false;
+            }
+            auto& keyboard = app->getKeyboard();
+            right_keys = (int)keyboard.isPressed(GLFW_KEY_D) + (int)keyboard.isPressed(GLFW_KEY_RIGHT);
+            left_keys = (int)keyboard.isPressed(GLFW_KEY_A) + (int)keyboard.isPressed(GLFW_KEY_LEFT);
+        }
+
+        // This should be called every step to update all entities containing a FreeCameraControllerComponent 
         void update(World* world, float deltaTime) {
             // First of all, we search for an entity containing both a CameraComponent and a FreeCameraControllerComponent
             // As soon as we find one, we break
@@ -44,126 +76,79 @@ namespace our
             FreeCameraControllerComponent *controller = nullptr;
             RunningObject *running = nullptr;
 
-            for (auto entity : world->getEntities())
-            {
-                camera = entity->getComponent<CameraComponent>();
-                controller = entity->getComponent<FreeCameraControllerComponent>();
-                if (camera && controller)
-                    break;
-            }
-            // If there is no entity with RunningObject, we can do nothing so we return
-            for (auto entity : world->getEntities())
-            {
-                running = entity->getComponent<RunningObject>();
-                if (running)
-                    break;
-            }
-
-            // If there is no entity with running, we can do nothing so we return
-            if(!(running)) return;
+            world->view<CameraComponent, FreeCameraControllerComponent>().each([&](Entity*, CameraComponent& cameraComponent, FreeCameraControllerComponent& controllerComponent){
+                if (camera) return;
+                camera = &cameraComponent;
+                controller = &controllerComponent;
+            });
+            // We search for the entity containing a RunningObject
+            world->view<RunningObject>().each([&](Entity*, RunningObject& runningObject){
+                if (!running) running = &runningObject;
+            });
+
+            // If there is no entity with running or no controlled camera, we can do nothing so we return
+            if(!(running) || !(camera)) return;
             // Get the entity that we found via getOwner of RunningObject (we could use controller->getOwner())
 
             Entity* entity = camera->getOwner();
             // Entity* entity = running->getOwner();
 
-            // If the left mouse button is pressed, we lock and hide the mouse. This common in First Person Games.
-            if(app->getMouse().isPressed(GLFW_MOUSE_BUTTON_1) && !mouse_locked){
-                app->getMouse().lockMouse(app->getWindow());
-                mouse_locked = true;
-            // If the left mouse button is released, we unlock and unhide the mouse.
-            } else if(!app->getMouse().isPressed(GLFW_MOUSE_BUTTON_1) && mouse_locked) {
-                app->getMouse().unlockMouse(app->getWindow());
-                mouse_locked = false;
-            }
-
             // We get a reference to the entity's position
             glm::vec3 world_position = entity->getLocalToWorldMatrix()*glm::vec4(0,0,0,1);
             // glm::vec3 position = lightSources[i]->getOwner()->getLocalToWorldMatrix()*glm::vec4(0,0,0,1);
-            glm::vec3& position = entity->localTransform.position;
-
-            // create instatse of CollisionComponent
-            Entity *collisionEntity = nullptr;
-            CollisionComponent *Collision = nullptr;
+            glm::vec3 position = entity->getLocalTransform().position;
 
+            // we only handle the first collision found in this frame
+            bool collided = false;
 
-
-            // for loop for all intities in the world:
-            for (auto entity : world->getEntities())
+            // We only test the collidables near the player (see "CollisionSystem")
+            // The player is tested as the segment it moved along since the last check, so a long step can't skip over an obstacle
+            glm::vec2 player_position(world_position.x, world_position.z);
+            if(!has_last_player_position) last_player_position = player_position;
+            uint32_t player_mask = collisions->getLayerMask(player_category);
+            collisions->query(last_player_position, player_position, player_mask, [&](Entity* collisionEntity, CollisionComponent& Collision)
             {
-                // try to found Collision entity
-                Collision = entity->getComponent<CollisionComponent>();
-                // if not found, continue
-                if (!(Collision)) continue;
-                // if found, get access of it.
-                collisionEntity = Collision->getOwner();
-
-                // access position for the collisionEntity
-                glm::vec3 &collisionPosition = collisionEntity->localTransform.position;
-
-                // collisionX that refer to if there is a collision in x axis
-                bool collisionX = false;
-                 // collisionZ that refer to if there is a collision in y axis
-                bool collisionZ = false;
+                // if we already collided with an entity in this frame, skip the rest
+                if (collided) return;
+                // skip the obstacles we already hit (they are only deleted at the end of the frame)
+                if (collisionEntity->isMarkedForRemoval()) return;
+
+                // reomve the collision entity (recorded in the command buffer so it is deleted when the commands are played back)
+                world->getCommandBuffer().destroy(collisionEntity->getHandle());
                 // if collision type is penalty:
-                if (Collision->getCollisionType() == "penalty")
-                {
-                    // check if it's hit it or not and store it in collisionX
-                    collisionX = world_position.x + 0.2 >= collisionPosition.x &&
-                                 collisionPosition.x + 0.2 >= world_position.x;
-
-                    collisionZ = world_position.z + 2 >= collisionPosition.z &&
-                                  collisionPosition.z + 2 >= world_position.z;
+                if (Collision.category == penalty_category){
+                    // if(app->reward == 0 || app->reward < 0){
+                    //     app->penalty = true;
+                    //     app->reward = 0;
+                    //     return;
+                    // }
+                    // app->reward -= 10;
+                    // if(app->reward == 0 || app->reward < 0){
+                    //     app->penalty = true;
+                    //     app->reward = 0;
+                    //     return;
+                    // }
+                    // PlaySound("assets/sound/lose.wav", NULL, SND_ASYNC);
+
+                    // make penalty to true
+                    app->penalty = true;
                 }
                 // if collision type is reward:
-                else
-                {
-                    // check if it's hit it or not and store it in collisionX
-                    collisionX = world_position.x + 1.5 >= collisionPosition.x &&
-                                 collisionPosition.x + 1.5 >= world_position.x;
-
-                    collisionZ = world_position.z + 6 >= collisionPosition.z &&
-                                  collisionPosition.z + 6 >= world_position.z;
-                }
-               
-
-                // if there is collision in both x, y axies
-                if (collisionX && collisionZ)
-                {
-                    // reomve the collision entity
-                    world->markForRemoval(collisionEntity);
-                    // if collision type is penalty:
-                    if (Collision->getCollisionType() == "penalty"){
-                        // if(app->reward == 0 || app->reward < 0){
-                        //     app->penalty = true;
-                        //     app->reward = 0;
-                        //     return;
-                        // }
-                        // app->reward -= 10;
-                        // if(app->reward == 0 || app->reward < 0){
-                        //     app->penalty = true;
-                        //     app->reward = 0;
-                        //     return;
-                        // }
-                        // PlaySound("assets/sound/lose.wav", NULL, SND_ASYNC);
-
-                        // make penalty to true
-                        app->penalty = true;
-                    }
-                    // if collision type is reward:
-                    else{
-                        // play win sound
-                        PlaySound("assets/sound/win.wav", NULL, SND_ASYNC);
-                        // add 10 for rewards
-                        app->reward += 10;
-
-                    }
-
-                    break;
+                else{
+                    // play win sound
+                    PlaySound("assets/sound/win.wav", NULL, SND_ASYNC);
+                    // add 10 for rewards
+                    app->reward += 10;
+
                 }
-            }
+
+                collided = true;
+            });
+            last_player_position = player_position;
+            has_last_player_position = true;
 
             // We get the camera model matrix (relative to its parent) to compute the front, up and right directions
-            glm::mat4 matrix = entity->localTransform.toMat4();
+            glm::mat4 matrix = entity->getLocalTransform().toMat4();
 
             glm::vec3 front = glm::vec3(matrix * glm::vec4(0, 0, -1, 0)),
                       up = glm::vec3(matrix * glm::vec4(0, 1, 0, 0)), 
@@ -177,15 +162,15 @@ namespace our
             if (position.x < 7)
             {
                 // D or left button moves the player left
-                if(app->getKeyboard().isPressed(GLFW_KEY_D)) position += right * (deltaTime * current_sensitivity.x);
-                if (app->getKeyboard().isPressed(GLFW_KEY_RIGHT)) position += right * (deltaTime * current_sensitivity.x);
+                position += right * ((float)right_keys * deltaTime * current_sensitivity.x);
             }
             if (position.x > -7)
             {
                 // A or right button moves the player right
-                if(app->getKeyboard().isPressed(GLFW_KEY_A)) position -= right * (deltaTime * current_sensitivity.x);
-                if (app->getKeyboard().isPressed(GLFW_KEY_LEFT)) position -= right * (deltaTime * current_sensitivity.x);
+                position -= right * ((float)left_keys * deltaTime * current_sensitivity.x);
             }
+            // Setting the position marks the cached world matrices of the camera (and its children) dirty
+            entity->setPosition(position);
            }
 
         // When the state exits, it should call this function to ensure the mouse is unlocked
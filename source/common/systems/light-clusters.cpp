@@ -0,0 +1,203 @@
+#include "light-clusters.hpp"
+
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace our {
+
+    // The light types used by "LightComponent" and "lighted.frag"
+    static constexpr float DIRECTIONAL = 0.0f, SPOT = 2.0f;
+
+    void LightClusters::configure(glm::uvec3 gridSize, float threshold) {
+        this->gridSize = glm::max(gridSize, glm::uvec3(1));
+        this->threshold = threshold;
+    }
+
+    float LightClusters::getRange(const ClusterLight& light, float threshold) {
+        float intensity = glm::max(glm::max(light.diffuse.r, glm::max(light.diffuse.g, light.diffuse.b)),
+            glm::max(light.specular.r, glm::max(light.specular.g, light.specular.b)));
+        if(intensity <= 0.0f) return 0.0f;
+        // The light is below the threshold where a*d^2 + b*d + c > intensity / threshold
+        float limit = intensity / threshold;
+        float a = light.attenuation.x, b = light.attenuation.y, c = light.attenuation.z - limit;
+        if(c >= 0.0f) return 0.0f;
+        if(a > 0.0f) return (-b + std::sqrt(b * b - 4.0f * a * c)) / (2.0f * a);
+        if(b > 0.0f) return -c / b;
+        return std::numeric_limits<float>::infinity();
+    }
+
+    glm::vec4 LightClusters::getInfluenceSphere(const ClusterLight& light, float threshold) {
+        float range = getRange(light, threshold);
+        glm::vec3 center = light.position;
+        float radius = range;
+        if(light.type == SPOT && range > 0.0f && std::isfinite(range) && light.outerAngle < glm::half_pi<float>()) {
+            float axisLength = glm::length(light.direction);
+            if(axisLength > 0.0f) {
+                glm::vec3 axis = light.direction / axisLength;
+                float cosine = std::cos(light.outerAngle);
+                if(light.outerAngle > glm::quarter_pi<float>()) {
+                    // The wide cones are bounded by the circle where the cone meets the range
+                    center += axis * (range * cosine);
+                    radius = range * std::sin(light.outerAngle);
+                } else {
+                    // The narrow cones are bounded by the sphere through the apex and the circle at the end of the range
+                    radius = range / (2.0f * cosine);
+                    center += axis * radius;
+                }
+            }
+        }
+        return glm::vec4(center, radius);
+    }
+
+    uint32_t LightClusters::getSlice(float depth) const {
+        if(depth <= near) return 0;
+        float slice = std::floor(std::log(depth / near) * slicesPerLog);
+        return (uint32_t)glm::min(slice, (float)(gridSize.z - 1));
+    }
+
+    void LightClusters::computeClusterBounds(const glm::mat4& P, float near, float far) {
+        this->near = near;
+        slicesPerLog = (float)gridSize.z / std::log(far / near);
+        glm::mat4 inverseP = glm::inverse(P);
+        // Returns the point of the tile corner (in NDC) at the given distance from the camera
+        // It moves along the line between the corner on the near plane and the corner on the far plane,
+        // so it works for both the perspective and the orthographic projections.
+        auto corner = [&inverseP](float x, float y, float depth){
+            glm::vec4 onNear = inverseP * glm::vec4(x, y, -1, 1), onFar = inverseP * glm::vec4(x, y, 1, 1);
+            glm::vec3 nearPoint = glm::vec3(onNear) / onNear.w, farPoint = glm::vec3(onFar) / onFar.w;
+            float t = (depth + nearPoint.z) / (nearPoint.z - farPoint.z);
+            return glm::mix(nearPoint, farPoint, t);
+        };
+        size_t count = (size_t)gridSize.x * gridSize.y * gridSize.z;
+        clusterMin.resize(count);
+        clusterMax.resize(count);
+        for(uint32_t z = 0; z < gridSize.z; z++) {
+            float depths[2] = { near * std::exp(z / slicesPerLog), near * std::exp((z + 1) / slicesPerLog) };
+            for(uint32_t y = 0; y < gridSize.y; y++) {
+                for(uint32_t x = 0; x < gridSize.x; x++) {
+                    glm::vec3 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+                    for(int cornerIndex = 0; cornerIndex < 8; cornerIndex++) {
+                        float ndcX = -1.0f + 2.0f * (x + (cornerIndex & 1)) / gridSize.x;
+                        float ndcY = -1.0f + 2.0f * (y + ((cornerIndex >> 1) & 1)) / gridSize.y;
+                        glm::vec3 point = corner(ndcX, ndcY, depths[cornerIndex >> 2]);
+                        low = glm::min(low, point);
+                        high = glm::max(high, point);
+                    }
+                    size_t index = ((size_t)z * gridSize.y + y) * gridSize.x + x;
+                    clusterMin[index] = low;
+                    clusterMax[index] = high;
+                }
+            }
+        }
+    }
+
+    void LightClusters::build(const glm::mat4& V, const glm::mat4& P, float near, float far) {
+        if(P != cachedProjection || near != cachedNear || far != cachedFar || gridSize != cachedGridSize) {
+            computeClusterBounds(P, near, far);
+            cachedProjection = P;
+            cachedNear = near;
+            cachedFar = far;
+            cachedGridSize = gridSize;
+        }
+        stats = ClusterStats();
+
+        // The directional lights go first so that the shader can loop over them without a list
+        auto firstLocal = std::stable_partition(lights.begin(), lights.end(), [](const ClusterLight& light){ return light.type == DIRECTIONAL; });
+        directionalCount = (uint32_t)(firstLocal - lights.begin());
+        stats.lights = lights.size();
+        stats.directional = directionalCount;
+
+        pairClusters.clear();
+        pairLights.clear();
+        spheres.resize(lights.size() - directionalCount);
+        for(uint32_t lightIndex = directionalCount; lightIndex < (uint32_t)lights.size(); lightIndex++) {
+            glm::vec4 sphere = getInfluenceSphere(lights[lightIndex], threshold);
+            spheres[lightIndex - directionalCount] = sphere;
+            if(!(sphere.w > 0.0f)) continue;
+
+            // The sphere is moved to the view space (the view matrix doesn't scale, so the radius is the same)
+            glm::vec3 center = glm::vec3(V * glm::vec4(glm::vec3(sphere), 1.0f));
+            float radius = sphere.w;
+
+            // Then find the clusters that the sphere could touch: first the slices, then the tiles
+            float depthMin = -center.z - radius, depthMax = -center.z + radius;
+            if(depthMax < near || depthMin > far) continue;
+            uint32_t sliceBegin = getSlice(depthMin), sliceEnd = getSlice(glm::min(depthMax, far));
+            uint32_t tileBegin[2] = { 0, 0 }, tileEnd[2] = { gridSize.x - 1, gridSize.y - 1 };
+            if(depthMin > near && std::isfinite(radius)) {
+                // If the sphere is in front of the near plane, the corners of its box project to a rectangle containing it
+                glm::vec2 low(std::numeric_limits<float>::max()), high(-std::numeric_limits<float>::max());
+                for(int corner = 0; corner < 8; corner++) {
+                    glm::vec3 offset((corner & 1) ? radius : -radius, (corner & 2) ? radius : -radius, (corner & 4) ? radius : -radius);
+                    glm::vec4 clip = P * glm::vec4(center + offset, 1.0f);
+                    glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                    low = glm::min(low, ndc);
+                    high = glm::max(high, ndc);
+                }
+                for(int axis = 0; axis < 2; axis++) {
+                    float tiles = (float)gridSize[axis];
+                    if(high[axis] < -1.0f || low[axis] > 1.0f) { tileBegin[axis] = 1; tileEnd[axis] = 0; continue; }
+                    tileBegin[axis] = (uint32_t)glm::clamp((low[axis] + 1.0f) * 0.5f * tiles, 0.0f, tiles - 1.0f);
+                    tileEnd[axis] = (uint32_t)glm::clamp((high[axis] + 1.0f) * 0.5f * tiles, 0.0f, tiles - 1.0f);
+                }
+            }
+
+            // Finally, the sphere is tested against the box of each candidate cluster
+            float radiusSquared = radius * radius;
+            for(uint32_t z = sliceBegin; z <= sliceEnd; z++) {
+                for(uint32_t y = tileBegin[1]; y <= tileEnd[1]; y++) {
+                    for(uint32_t x = tileBegin[0]; x <= tileEnd[0]; x++) {
+                        uint32_t cluster = (z * gridSize.y + y) * gridSize.x + x;
+                        glm::vec3 outside = glm::max(glm::max(clusterMin[cluster] - center, center - clusterMax[cluster]), glm::vec3(0.0f));
+                        if(glm::dot(outside, outside) > radiusSquared) continue;
+                        if(pairClusters.size() == maxIndices) { stats.dropped++; continue; }
+                        pairClusters.push_back(cluster);
+                        pairLights.push_back(lightIndex);
+                    }
+                }
+            }
+        }
+
+        // The pairs are grouped by cluster with a counting sort (the lights of each cluster keep their order)
+        size_t clusterCount = (size_t)gridSize.x * gridSize.y * gridSize.z;
+        grid.assign(2 * clusterCount, 0);
+        for(uint32_t cluster : pairClusters) grid[2 * cluster + 1]++;
+        uint32_t offset = 0;
+        for(size_t cluster = 0; cluster < clusterCount; cluster++) {
+            grid[2 * cluster] = offset;
+            offset += grid[2 * cluster + 1];
+            stats.maxPerCluster = glm::max(stats.maxPerCluster, (size_t)grid[2 * cluster + 1]);
+        }
+        indices.resize(pairClusters.size());
+        // The offsets are used as write cursors, then moved back to the start of each list
+        for(size_t pair = 0; pair < pairClusters.size(); pair++) indices[grid[2 * pairClusters[pair]]++] = pairLights[pair];
+        for(size_t cluster = 0; cluster < clusterCount; cluster++) grid[2 * cluster] -= grid[2 * cluster + 1];
+        stats.indices = indices.size();
+    }
+
+    size_t LightClusters::selectLights(const BoundingBox& box, size_t cap, std::vector<uint32_t>& selected) const {
+        selected.clear();
+        candidates.clear();
+        for(uint32_t sphereIndex = 0; sphereIndex < (uint32_t)spheres.size(); sphereIndex++) {
+            const glm::vec4& sphere = spheres[sphereIndex];
+            if(!(sphere.w > 0.0f)) continue;
+            glm::vec3 outside = glm::max(glm::max(box.min - glm::vec3(sphere), glm::vec3(sphere) - box.max), glm::vec3(0.0f));
+            if(glm::dot(outside, outside) > sphere.w * sphere.w) continue;
+            // The relevance is the attenuated intensity at the point of the box nearest to the light
+            const ClusterLight& light = lights[directionalCount + sphereIndex];
+            float distance = glm::length(glm::max(glm::max(box.min - light.position, light.position - box.max), glm::vec3(0.0f)));
+            float intensity = glm::max(glm::max(light.diffuse.r, glm::max(light.diffuse.g, light.diffuse.b)),
+                glm::max(light.specular.r, glm::max(light.specular.g, light.specular.b)));
+            float relevance = intensity / glm::dot(light.attenuation, glm::vec3(distance * distance, distance, 1.0f));
+            candidates.push_back({ relevance, directionalCount + sphereIndex });
+        }
+        size_t kept = glm::min(cap, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + kept, candidates.end(),
+            [](const std::pair<float, uint32_t>& first, const std::pair<float, uint32_t>& second){ return first.first > second.first; });
+        for(size_t index = 0; index < kept; index++) selected.push_back(candidates[index].second);
+        return candidates.size();
+    }
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../mesh/bounds.hpp"
+#include <glm/glm.hpp>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+namespace our {
+
+    // A light as it is stored in the light buffer read by "lighted.frag" (5 RGBA32F texels per light)
+    // The order of the members must match "read_light" in the shader.
+    struct ClusterLight {
+        glm::vec3 position;    float type;       // The type is stored as a float since the texels are floats
+        glm::vec3 direction;   float padding0;
+        glm::vec3 diffuse;     float innerAngle; // The cone angles are only used by the spot lights
+        glm::vec3 specular;    float outerAngle;
+        glm::vec3 attenuation; float padding1;   // x*d^2 + y*d + z
+    };
+    static_assert(sizeof(ClusterLight) == 5 * 4 * sizeof(float), "A cluster light must fill exactly 5 texels");
+
+    // The counters of the last light assignment (shown in the stats window)
+    struct ClusterStats {
+        size_t lights = 0;            // The number of lights in the light buffer
+        size_t directional = 0;       // The directional lights (they light every cluster, so they are not in the lists)
+        size_t indices = 0;           // The total length of the cluster light lists
+        size_t maxPerCluster = 0;     // The longest list of a single cluster
+        size_t dropped = 0;           // The assignments that didn't fit in the index list (see "setMaxIndices")
+    };
+
+    // Splits the camera frustum into a 3D grid of clusters and finds the lights that can reach each cluster.
+    // The grid is uniform on the screen (x & y) and exponential in depth (z), so the clusters near the camera are thin.
+    // Each point & spot light is bounded by the sphere (or the cone) where its attenuated color is above a threshold,
+    // so a fragment only needs to evaluate the lights listed for its cluster.
+    class LightClusters {
+        glm::uvec3 gridSize = glm::uvec3(16, 9, 24);
+        float threshold = 1.0f / 256.0f;
+        size_t maxIndices = SIZE_MAX;
+
+        std::vector<ClusterLight> lights;
+        uint32_t directionalCount = 0;
+        // The world space sphere reached by each light after the directional ones (xyz: center, w: radius, 0 if it reaches nothing)
+        std::vector<glm::vec4> spheres;
+        // 2 integers per cluster: the offset of its list in "indices" and the number of lights in it
+        std::vector<uint32_t> grid;
+        std::vector<uint32_t> indices;
+        ClusterStats stats;
+
+        // The bounds of each cluster in the view space. They only depend on the projection, so they are cached.
+        std::vector<glm::vec3> clusterMin, clusterMax;
+        glm::mat4 cachedProjection = glm::mat4(0.0f);
+        float cachedNear = 0, cachedFar = 0;
+        glm::uvec3 cachedGridSize = glm::uvec3(0);
+        float near = 1, slicesPerLog = 1;
+
+        // (cluster, light) pairs found by "build" before they are grouped by cluster (kept to prevent reallocating them)
+        std::vector<uint32_t> pairClusters, pairLights;
+        // The candidates of "selectLights" with their relevance (kept for the same reason)
+        mutable std::vector<std::pair<float, uint32_t>> candidates;
+
+        void computeClusterBounds(const glm::mat4& P, float near, float far);
+        uint32_t getSlice(float depth) const;
+
+    public:
+        // "gridSize" is the number of clusters on each axis & "threshold" is the attenuated intensity below which a light is ignored
+        void configure(glm::uvec3 gridSize, float threshold);
+        // Limits the total length of the lists (the size of the index buffer that the GPU can read)
+        void setMaxIndices(size_t count) { maxIndices = count; }
+
+        void clear() { lights.clear(); }
+        void add(const ClusterLight& light) { lights.push_back(light); }
+
+        // Assigns the lights to the clusters of the camera with the given view & projection matrices
+        // The directional lights are moved to the start of the light list. The lists hold the indices of the other lights.
+        void build(const glm::mat4& V, const glm::mat4& P, float near, float far);
+
+        // Finds the point & spot lights that reach the box (a world space box) and writes the indices of the "cap" most relevant ones
+        // to "selected" (the lights that are the brightest at the box first). Must be called after "build".
+        // Returns the number of lights that reach the box (which is more than the size of "selected" if some were dropped).
+        size_t selectLights(const BoundingBox& box, size_t cap, std::vector<uint32_t>& selected) const;
+
+        const std::vector<ClusterLight>& getLights() const { return lights; }
+        uint32_t getDirectionalCount() const { return directionalCount; }
+        const std::vector<uint32_t>& getGrid() const { return grid; }
+        const std::vector<uint32_t>& getIndices() const { return indices; }
+        glm::uvec3 getGridSize() const { return gridSize; }
+        // The shader finds the slice of a fragment as floor(log(depth / near) * slicesPerLog)
+        float getNear() const { return near; }
+        float getSlicesPerLog() const { return slicesPerLog; }
+        const ClusterStats& getStats() const { return stats; }
+
+        // Returns the distance where the light's color (its brightest channel) falls below the threshold after attenuation
+        // It is infinite if the attenuation doesn't grow with the distance and 0 if the light is always below the threshold.
+        static float getRange(const ClusterLight& light, float threshold);
+        // Returns a sphere (xyz: center, w: radius) containing the volume lit by the light above the threshold
+        // The spot lights get the sphere around their cone, which is smaller than their range when the cone is narrow.
+        static glm::vec4 getInfluenceSphere(const ClusterLight& light, float threshold);
+    };
+
+}
@@ -0,0 +1,37 @@
+#include "render-queue.hpp"
+
+#include <utility>
+
+namespace our {
+
+    void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+        size_t count = items.size();
+        if(count < 2) return;
+        scratch.resize(count);
+        // The histograms of all the passes are counted in one read of the keys
+        size_t histograms[8][256] = {};
+        for(const SortItem& item : items)
+            for(int pass = 0; pass < 8; pass++)
+                histograms[pass][(item.key >> (8 * pass)) & 0xFF]++;
+        SortItem* source = items.data();
+        SortItem* destination = scratch.data();
+        for(int pass = 0; pass < 8; pass++) {
+            size_t* histogram = histograms[pass];
+            // If all the keys have the same byte, this pass wouldn't move anything
+            if(histogram[(source[0].key >> (8 * pass)) & 0xFF] == count) continue;
+            // The histogram becomes the position of the first item of each bucket
+            size_t offset = 0;
+            for(int bucket = 0; bucket < 256; bucket++) {
+                size_t bucketSize = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketSize;
+            }
+            for(size_t index = 0; index < count; index++)
+                destination[histogram[(source[index].key >> (8 * pass)) & 0xFF]++] = source[index];
+            std::swap(source, destination);
+        }
+        // After an odd number of passes, the sorted items are in the scratch buffer
+        if(source != items.data()) items.swap(scratch);
+    }
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace our {
+
+    // An entry of the draw queue: the sort key of a render command and the index of the command
+    struct SortItem {
+        uint64_t key;
+        uint32_t command;
+    };
+
+    // The layout of the sort keys of the opaque commands (from the most significant bits to the least)
+    // Sorting by the key groups the draws that share a shader, then a pipeline state, then a material and then a mesh,
+    // so consecutive draws change as little state as possible. Inside a group, the draws are ordered front to back.
+    // The IDs are truncated to their field, so two objects can share a field value. This only makes the grouping less tight
+    // since the renderer compares the objects themselves before skipping a bind.
+    namespace sort_key {
+        constexpr int SHADER_BITS = 12, PIPELINE_BITS = 8, MATERIAL_BITS = 14, MESH_BITS = 14, DEPTH_BITS = 16;
+        static_assert(SHADER_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64, "The sort key fields must fill 64 bits");
+
+        // Packs the key. "depth" is the distance to the camera divided by the far plane distance (it is clamped to [0, 1]).
+        inline uint64_t make(uint32_t shader, uint32_t pipeline, uint32_t material, uint32_t mesh, float depth) {
+            auto field = [](uint32_t value, int bits){ return (uint64_t)value & ((uint64_t(1) << bits) - 1); };
+            float clamped = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+            uint64_t quantized = (uint64_t)(clamped * (float)((1 << DEPTH_BITS) - 1));
+            uint64_t key = field(shader, SHADER_BITS);
+            key = (key << PIPELINE_BITS) | field(pipeline, PIPELINE_BITS);
+            key = (key << MATERIAL_BITS) | field(material, MATERIAL_BITS);
+            key = (key << MESH_BITS) | field(mesh, MESH_BITS);
+            key = (key << DEPTH_BITS) | quantized;
+            return key;
+        }
+    }
+
+    // Sorts the items by key (least significant byte first, 8 bits per pass). The sort is stable.
+    // The passes where all the keys share the same byte are skipped, so keys that only differ in a few fields are cheap to sort.
+    // "scratch" is used as the second buffer of the passes (it is passed in to prevent reallocating it every frame).
+    void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+
+}
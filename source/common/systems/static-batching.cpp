@@ -0,0 +1,110 @@
+#include "static-batching.hpp"
+#include "../components/mesh-renderer.hpp"
+#include "../components/movement.hpp"
+#include "../components/camera.hpp"
+#include "../components/free-camera-controller.hpp"
+#include "../components/running-object.hpp"
+#include "../components/collision.hpp"
+
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include <cmath>
+
+namespace our {
+
+    bool StaticBatcher::isStatic(const Entity* entity) {
+        // A moving parent moves its children too, so the whole chain of ancestors is checked
+        for(; entity; entity = entity->getParent()) {
+            if(entity->hasComponent<MovementComponent>() || entity->hasComponent<CameraComponent>() ||
+                entity->hasComponent<FreeCameraControllerComponent>() || entity->hasComponent<RunningObject>() ||
+                entity->hasComponent<CollisionComponent>())
+                return false;
+        }
+        return true;
+    }
+
+    void StaticBatcher::build(World* world, const nlohmann::json& config) {
+        clear();
+        if(!config.value("enabled", false)) return;
+        float chunkSize = config.value("chunkSize", 32.0f);
+        size_t minEntities = config.value("minEntities", (size_t)2);
+
+        // The static renderers are grouped by material & chunk. The map is sorted by the material ID (not its address)
+        // so the chunks are created in the same order every time the scene is loaded.
+        struct Group {
+            Material* material = nullptr;
+            std::vector<Entity*> entities;
+        };
+        std::map<std::tuple<uint32_t, int, int>, Group> groups;
+        world->view<MeshRendererComponent>().each([&](Entity* entity, MeshRendererComponent& renderer){
+            if(!renderer.mesh || !renderer.material || renderer.material->transparent) return;
+            if(!isStatic(entity)) return;
+            glm::vec3 center = renderer.mesh->getBounds().box.transform(entity->getLocalToWorldMatrix()).getCenter();
+            auto key = std::make_tuple(renderer.material->getId(),
+                (int)std::floor(center.x / chunkSize), (int)std::floor(center.z / chunkSize));
+            Group& group = groups[key];
+            group.material = renderer.material;
+            group.entities.push_back(entity);
+        });
+
+        // Each source mesh is read back from the GPU once, even if many entities use it
+        std::unordered_map<const Mesh*, std::pair<std::vector<Vertex>, std::vector<unsigned int>>> sources;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> elements;
+        for(auto& [key, group] : groups) {
+            if(group.entities.size() < minEntities || group.entities.size() < 2) continue;
+            vertices.clear();
+            elements.clear();
+            for(Entity* entity : group.entities) {
+                const Mesh* mesh = entity->getComponent<MeshRendererComponent>()->mesh;
+                auto found = sources.find(mesh);
+                if(found == sources.end()) {
+                    found = sources.emplace(mesh, std::pair<std::vector<Vertex>, std::vector<unsigned int>>()).first;
+                    mesh->readBack(found->second.first, found->second.second);
+                }
+                const std::vector<Vertex>& sourceVertices = found->second.first;
+                const std::vector<unsigned int>& sourceElements = found->second.second;
+
+                const glm::mat4& M = entity->getLocalToWorldMatrix();
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(M)));
+                // A mirroring transform flips the winding of the triangles, so we swap two corners to keep the front faces
+                bool mirrored = glm::determinant(glm::mat3(M)) < 0.0f;
+                unsigned int base = (unsigned int)vertices.size();
+                for(Vertex vertex : sourceVertices) {
+                    vertex.position = glm::vec3(M * glm::vec4(vertex.position, 1.0f));
+                    glm::vec3 normal = normalMatrix * vertex.normal;
+                    float length = glm::length(normal);
+                    if(length > 0.0f) vertex.normal = normal / length;
+                    vertices.push_back(vertex);
+                }
+                for(size_t corner = 0; corner + 2 < sourceElements.size(); corner += 3) {
+                    elements.push_back(base + sourceElements[corner]);
+                    elements.push_back(base + sourceElements[corner + (mirrored ? 2 : 1)]);
+                    elements.push_back(base + sourceElements[corner + (mirrored ? 1 : 2)]);
+                }
+            }
+
+            Mesh* merged = new Mesh(vertices, elements);
+            meshes.push_back(merged);
+            Entity* chunk = world->add();
+            chunk->name = "static batch";
+            MeshRendererComponent* renderer = chunk->addComponent<MeshRendererComponent>();
+            renderer->mesh = merged;
+            renderer->material = group.material;
+            // The merged entities keep their other components (e.g. lights), only their mesh renderers are removed
+            for(Entity* entity : group.entities) entity->deleteComponent<MeshRendererComponent>();
+
+            stats.entities += group.entities.size();
+            stats.chunks++;
+            stats.vertices += vertices.size();
+        }
+    }
+
+    void StaticBatcher::clear() {
+        for(Mesh* mesh : meshes) delete mesh;
+        meshes.clear();
+        stats = StaticBatchingStats();
+    }
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "../ecs/world.hpp"
+#include "../mesh/mesh.hpp"
+#include <json/json.hpp>
+#include <vector>
+
+namespace our {
+
+    // The result of the last static batching (shown in the stats window)
+    struct StaticBatchingStats {
+        size_t entities = 0; // The mesh renderers merged into the chunks
+        size_t chunks = 0;   // The merged meshes (each one is drawn with a single draw call)
+        size_t vertices = 0; // The vertices of all the merged meshes
+    };
+
+    // Merges the mesh renderers that never move into a few big meshes when a scene is loaded.
+    // An entity is static if neither it nor its ancestors have a component that moves it or removes it while playing
+    // (movement, camera, camera controller, running object & collision). The static renderers are grouped by material
+    // and by chunk, where the chunks are the cells of a grid on the ground (x & z) so that the frustum culling can still skip
+    // the parts of the level that are out of view. The vertices of each group are transformed to the world space once
+    // and merged into one mesh drawn by a new entity (with an identity transform) that replaces their mesh renderers.
+    class StaticBatcher {
+        std::vector<Mesh*> meshes; // The merged meshes (owned by the batcher)
+        StaticBatchingStats stats;
+
+        static bool isStatic(const Entity* entity);
+
+    public:
+        // The config can contain "enabled" (false by default), "chunkSize" (the width of a chunk in world units)
+        // & "minEntities" (the smallest group worth merging)
+        void build(World* world, const nlohmann::json& config);
+        // Deletes the merged meshes (call it after clearing the world since the chunk entities draw them)
+        void clear();
+
+        const StaticBatchingStats& getStats() const { return stats; }
+
+        StaticBatcher() = default;
+        ~StaticBatcher() { clear(); }
+        StaticBatcher(const StaticBatcher&) = delete;
+        StaticBatcher& operator=(const StaticBatcher&) = delete;
+    };
+
+}
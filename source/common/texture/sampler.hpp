@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include "../gl-state.hpp"
 #include <json/json.hpp>
 #include <glm/vec4.hpp>
 
@@ -24,6 +25,7 @@ namespace our {
             //TODO: (Req 6) Complete this function
             //Delete sampler
             //glDeleteSamplers(number of sampler objects to be deleted, pointer to sampler array)
+            GLState::get().forgetSampler(name);
             glDeleteSamplers(1, &name);
         }
 
@@ -33,7 +35,7 @@ namespace our {
             //We use texture units to be able to use multiple textures in shaders 
             //so we need to bind sampler to texture unit
             //glBindSampler(texture unit index, sampler name)
-            glBindSampler(textureUnit, name);
+            GLState::get().bindSampler(textureUnit, name);
         }
 
         // This static method ensures that no sampler is bound to the given texture unit
@@ -41,7 +43,7 @@ namespace our {
             //TODO: (Req 6) Complete this function
             //Unind sampler
             //glBindSampler(texture index, 0 for unbinding)
-            glBindSampler(textureUnit, 0);
+            GLState::get().bindSampler(textureUnit, 0);
         }
 
         // This function sets a sampler paramter where the value is of type "GLint"
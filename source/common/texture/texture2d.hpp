@@ -1,6 +1,7 @@
 #pragma once
 
 #include <glad/gl.h>
+#include "../gl-state.hpp"
 
 namespace our {
 
@@ -22,6 +23,7 @@ namespace our {
             //TODO: (Req 5) Complete this function
             //Delete texture from memory 
             //glDeleteTextures(number of textures to be deleted, pointer to texture array)
+            GLState::get().forgetTexture(name);
             glDeleteTextures(1, &name);
         }
 
@@ -35,7 +37,7 @@ namespace our {
             //TODO: (Req 5) Complete this function
             //Bind texture (make it active and commands should operates on the active texture)
             //glBindTexture(texture target/type, texture name)
-            glBindTexture(GL_TEXTURE_2D, name);
+            GLState::get().bindTexture2D(name);
         }
 
         // This static method ensures that no texture is bound to GL_TEXTURE_2D
@@ -43,7 +45,7 @@ namespace our {
             //TODO: (Req 5) Complete this function
             //Unbind texture (deactivate the currently active texture)
             //glBindTexture(texture target/type, 0 for unbinding)
-            glBindTexture(GL_TEXTURE_2D, 0);
+            GLState::get().bindTexture2D(0);
         }
 
         Texture2D(const Texture2D&) = delete;
@@ -3,10 +3,16 @@
 #include <application.hpp>
 
 #include <ecs/world.hpp>
+#include <ecs/transform-batch.hpp>
 #include <systems/forward-renderer.hpp>
 #include <systems/free-camera-controller.hpp>
 #include <systems/movement.hpp>
+#include <systems/collision.hpp>
+#include <systems/static-batching.hpp>
+#include <mesh/geometry-arena.hpp>
+#include <ecs/system-scheduler.hpp>
 #include <asset-loader.hpp>
+#include <imgui.h>
 
 // This state shows how to use the ECS framework and deserialization.
 class Playstate: public our::State {
@@ -15,6 +21,11 @@ class Playstate: public our::State {
     our::ForwardRenderer renderer;
     our::FreeCameraControllerSystem cameraController;
     our::MovementSystem movementSystem;
+    our::CollisionSystem collisionSystem;
+    our::StaticBatcher staticBatcher; // Merges the mesh renderers that never move (after the world is loaded)
+    our::SystemScheduler scheduler; // Runs the logic systems on the thread pool
+    float stepDeltaTime = 0; // The delta time of the current simulation step (read by the scheduled systems)
+    bool showStats = false; // If true, a window showing the engine counters is drawn every frame
 
     void onInitialize() override {
         
@@ -35,22 +46,62 @@ class Playstate: public our::State {
         if(config.contains("assets")){
             our::deserializeAllAssets(config["assets"]);
         }
+        // The scene config can ask the world to store the components in archetype chunks
+        if(config.value("storage", "") == "archetype"){
+            world.setStorageMode(our::StorageMode::ARCHETYPE);
+        }
+        showStats = config.value("showStats", false);
         // If we have a world in the scene config, we use it to populate our world
         if(config.contains("world")){
             world.deserialize(config["world"]);
         }
-        // We initialize the camera controller system since it needs a pointer to the app
-        cameraController.enter(getApp());
+        // The static decoration is merged into a few chunk meshes (the settings are optional)
+        staticBatcher.build(&world, config.value("staticBatching", nlohmann::json::object()));
+        // The collision grid settings are optional. The grid is filled from the world, then it follows the world's changes.
+        collisionSystem.initialize(config.value("collision", nlohmann::json::object()), &world);
+        // We initialize the camera controller system since it needs a pointer to the app and the collision grid
+        cameraController.enter(getApp(), &collisionSystem);
+        // Then we tell the scheduler what each system reads & writes so that it knows which systems can run at the same time
+        // The collision grid is updated from the matrices resolved at the start of the step (the previous step's bounds),
+        // so it doesn't read the transforms that the movement system writes and both run at the same time.
+        // The camera controller queries the grid and moves the camera, so it runs after both of them.
+        // The camera controller uses the window & the input so it must run on the main thread
+        scheduler.clear();
+        scheduler.add("movement",
+            { our::accessOf<our::MovementComponent>(), our::accessOf<our::Transform>() },
+            [this](){ movementSystem.update(&world, stepDeltaTime); });
+        scheduler.add("collision",
+            { our::accessOf<our::CollisionComponent>(), our::accessOf<our::CollisionSystem>() },
+            [this](){ collisionSystem.update(); });
+        scheduler.add("camera controller",
+            { our::accessOf<our::CameraComponent, our::FreeCameraControllerComponent, our::RunningObject, our::CollisionComponent, our::CollisionSystem>(),
+              our::accessOf<our::Transform>() },
+            [this](){ cameraController.update(&world, stepDeltaTime); }, true);
         // Then we initialize the renderer
         auto size = getApp()->getFrameBufferSize();
         renderer.initialize(size, config["renderer"]);
     }
 
-    void onDraw(double deltaTime) override {
+    void onBeginFrame(double) override {
+        // The controller reads the mouse & keyboard here once per frame instead of in every step
+        cameraController.sampleInput();
+    }
+
+    void onFixedUpdate(double fixedDeltaTime) override {
+        // We remember where everything was before the step so that the frames drawn during the step can be interpolated
+        world.beginSimulationStep();
         // Here, we just run a bunch of systems to control the world logic
-        movementSystem.update(&world, (float)deltaTime);
-        cameraController.update(&world, (float)deltaTime);
-        world.deleteMarkedEntities();
+        stepDeltaTime = (float)fixedDeltaTime;
+        scheduler.run();
+        // The structural changes recorded by the systems are applied here, after all of them are done
+        // (the entities destroyed by the commands are deleted at the end of the playback)
+        world.playbackCommands();
+    }
+
+    void onDraw(double) override {
+        // We recompute the world matrices of the moved entities once, then blend them between the last two steps
+        // so that the motion looks smooth even if the frame rate doesn't match the simulation rate
+        world.interpolateTransforms((float)getApp()->getInterpolationAlpha());
         // And finally we use the renderer system to draw the scene
         renderer.render(&world);
 
@@ -63,13 +114,58 @@ class Playstate: public our::State {
         }
     }
 
+    void onImmediateGui() override {
+        if(!showStats) return;
+        ImGui::Begin("Stats");
+        // The allocation counters show whether spawning & despawning entities still reaches the system allocator
+        our::AllocationStats allocations = world.getAllocationStats();
+        ImGui::Text("Entities: %zu", world.getEntities().size());
+        ImGui::Text("Transform kernels: %s", our::kernels::getSimdPath());
+        ImGui::Text("Simulation steps this frame: %d (alpha: %.2f)", getApp()->getStepsThisFrame(), getApp()->getInterpolationAlpha());
+        ImGui::Text("Pool allocations: %llu (reused: %llu, freed: %llu)",
+            (unsigned long long)allocations.allocations, (unsigned long long)allocations.reuses, (unsigned long long)allocations.frees);
+        const our::CollisionStats& collisions = collisionSystem.getStats();
+        ImGui::Text("Collidables: %zu (cells: %zu, changes: %zu, moved: %zu, tested: %zu)",
+            collisions.proxies, collisions.cells, collisions.changes, collisions.updated, collisions.candidates);
+        const our::RenderStats& rendering = renderer.getStats();
+        ImGui::Text("Draws: %zu of %zu (frustum culled: %zu)", rendering.drawn, rendering.commands, rendering.culled);
+        ImGui::Text("Opaque binds: shader %zu, pipeline %zu, material %zu, vertex array %zu",
+            rendering.shaderBinds, rendering.pipelineBinds, rendering.materialBinds, rendering.vertexArrayBinds);
+        ImGui::Text("Opaque draw calls: %zu (instanced: %zu drawing %zu commands)",
+            rendering.drawCalls, rendering.instancedBatches, rendering.instancedCommands);
+        const our::StaticBatchingStats& batching = staticBatcher.getStats();
+        ImGui::Text("Static batches: %zu entities merged into %zu chunks (%zu vertices)", batching.entities, batching.chunks, batching.vertices);
+        our::GeometryArenaStats geometry = our::GeometryArena::get().getStats();
+        ImGui::Text("Geometry arena: %zu meshes, vertices %zu / %zu, elements %zu / %zu (free blocks: %zu)",
+            geometry.meshes, geometry.vertices, geometry.vertexCapacity, geometry.indices, geometry.indexCapacity, geometry.freeBlocks);
+        ImGui::Text("Lights: %zu (directional: %zu), cluster lists: %zu entries (longest: %zu, dropped: %zu)",
+            rendering.lights.lights, rendering.lights.directional, rendering.lights.indices, rendering.lights.maxPerCluster, rendering.lights.dropped);
+        ImGui::Text("Object light lists: %zu lights (over the cap: %zu)", rendering.objectLights, rendering.objectLightsDropped);
+        // The pre-pass can be switched here to compare the number of shaded fragments with & without it
+        bool depthPrepass = renderer.getDepthPrepass(), countFragments = renderer.getFragmentCounting();
+        if(ImGui::Checkbox("Depth pre-pass", &depthPrepass)) renderer.setDepthPrepass(depthPrepass);
+        ImGui::SameLine();
+        if(ImGui::Checkbox("Count shaded fragments", &countFragments)) renderer.setFragmentCounting(countFragments);
+        if(countFragments)
+            ImGui::Text("Opaque fragments shaded: %llu (pre-pass draws: %zu)", (unsigned long long)rendering.shadedFragments, rendering.prepassDraws);
+        const our::GLStateStats& glCalls = our::GLState::get().getFrameStats();
+        ImGui::Text("GL state calls: %llu issued, %llu elided",
+            (unsigned long long)glCalls.issued, (unsigned long long)glCalls.elided);
+        ImGui::Text("Pages allocated: %llu (freed: %llu)",
+            (unsigned long long)allocations.pageAllocations, (unsigned long long)allocations.pageFrees);
+        ImGui::End();
+    }
+
     void onDestroy() override {
         // Don't forget to destroy the renderer
         renderer.destroy();
         // On exit, we call exit for the camera controller system to make sure that the mouse is unlocked
         cameraController.exit();
+        collisionSystem.clear();
         // Clear the world
         world.clear();
+        // The chunk entities are gone, so their merged meshes can be deleted
+        staticBatcher.clear();
         // and we delete all the loaded assets to free memory on the RAM and the VRAM
         our::clearAllAssets();
     }